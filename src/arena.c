@@ -0,0 +1,121 @@
+/*
+ * <stdalign.h>
+ *  alignof()
+ *
+ * <stddef.h>
+ *  max_align_t
+ *
+ * <stdlib.h>
+ *  free()
+ *  malloc()
+ *  size_t
+ *
+ * <string.h>
+ *  memcpy()
+ */
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * <utils/common.h>
+ *  max()
+ */
+#include <utils/common.h>
+
+#include "arena.h"
+
+/**
+ * @brief Default size of a block, in bytes
+ */
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+/**
+ * @brief A block of memory of an Arena
+ */
+struct _arena_block {
+    /** The next (older) block */
+    struct _arena_block * next;
+    /** Size of `data`, in bytes */
+    size_t size;
+    /** Number of bytes of `data` already allocated */
+    size_t used;
+    /** The memory */
+    alignas(max_align_t) unsigned char data[];
+};
+
+void * arena_alloc (Arena * self, size_t size)
+{
+    if (self == NULL)
+        return NULL;
+
+    /* keep every allocation aligned */
+    size_t align = alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+
+    struct _arena_block * b = self->blocks;
+
+    if (b == NULL || b->size - b->used < size) {
+        size_t bsize = max(size, (size_t) ARENA_BLOCK_SIZE);
+
+        b = malloc(sizeof(struct _arena_block) + bsize);
+        if (b == NULL)
+            return NULL;
+
+        b->size = bsize;
+        b->used = 0;
+        b->next = self->blocks;
+        self->blocks = b;
+    }
+
+    void * ret = b->data + b->used;
+    b->used += size;
+    return ret;
+}
+
+char * arena_strndup (Arena * self, const char * str, size_t len)
+{
+    if (str == NULL)
+        return NULL;
+
+    char * ret = arena_alloc(self, len + 1);
+    if (ret != NULL) {
+        memcpy(ret, str, len);
+        ret[len] = '\0';
+    }
+
+    return ret;
+}
+
+void arena_merge (Arena * self, Arena * other)
+{
+    if (self == NULL || other == NULL || other->blocks == NULL)
+        return;
+
+    /* keep using the block `self` was using */
+    struct _arena_block * last = other->blocks;
+    while (last->next != NULL)
+        last = last->next;
+
+    if (self->blocks == NULL) {
+        self->blocks = other->blocks;
+    } else {
+        last->next = self->blocks->next;
+        self->blocks->next = other->blocks;
+    }
+
+    other->blocks = NULL;
+}
+
+void arena_free (Arena * self)
+{
+    if (self == NULL)
+        return;
+
+    while (self->blocks != NULL) {
+        struct _arena_block * next = self->blocks->next;
+        free(self->blocks);
+        self->blocks = next;
+    }
+}
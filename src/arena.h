@@ -0,0 +1,51 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/*
+ * <stdlib.h>
+ *  size_t
+ */
+#include <stdlib.h>
+
+/**
+ * @brief A bump allocator: memory is allocated from big blocks and
+ *     only ever released all at once, with `arena_free()`
+ */
+typedef struct {
+    /** Blocks allocated so far, the one in use first */
+    struct _arena_block * blocks;
+} Arena;
+
+/**
+ * @brief Allocate @a size bytes from @a self
+ * @param self The Arena
+ * @param size Number of bytes to allocate
+ * @returns A pointer to the allocated memory, suitably aligned for
+ *     any type, or `NULL` if an error occurred
+ */
+void * arena_alloc (Arena * self, size_t size);
+
+/**
+ * @brief Copy the first @a len bytes of @a str to @a self, and
+ *     `NULL` terminate the copy
+ * @param self The Arena
+ * @param str The string to copy
+ * @param len Number of bytes of @a str to copy
+ * @returns A pointer to the copy, or `NULL` if an error occurred
+ */
+char * arena_strndup (Arena * self, const char * str, size_t len);
+
+/**
+ * @brief Move all the memory of @a other to @a self, leaving @a other empty
+ * @param self The Arena
+ * @param other Another Arena
+ */
+void arena_merge (Arena * self, Arena * other);
+
+/**
+ * @brief Free all the memory allocated from @a self
+ * @param self The Arena
+ */
+void arena_free (Arena * self);
+
+#endif /* _ARENA_H */
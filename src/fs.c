@@ -0,0 +1,701 @@
+/* for `syscall()` and `DT_*` */
+#define _GNU_SOURCE
+
+/*
+ * <dirent.h>
+ *  DT_DIR
+ *  DT_LNK
+ *  DT_REG
+ *  DT_UNKNOWN
+ *
+ * <errno.h>
+ *  errno
+ *
+ * <fcntl.h>
+ *  AT_SYMLINK_NOFOLLOW
+ *  O_CLOEXEC
+ *  O_DIRECTORY
+ *  O_RDONLY
+ *  fstatat()
+ *  open()
+ *  openat()
+ *
+ * <linux/fiemap.h>
+ *  struct fiemap
+ *
+ * <linux/fs.h>
+ *  FS_IOC_FIEMAP
+ *
+ * <pthread.h>
+ *  pthread_cond_broadcast()
+ *  pthread_cond_wait()
+ *  pthread_create()
+ *  pthread_join()
+ *  pthread_mutex_lock()
+ *  pthread_mutex_unlock()
+ *
+ * <stdint.h>
+ *  uint64_t
+ *
+ * <stdio.h>
+ *  fprintf()
+ *  stderr
+ *
+ * <stdlib.h>
+ *  calloc()
+ *  free()
+ *  malloc()
+ *  qsort()
+ *  realloc()
+ *  size_t
+ *
+ * <string.h>
+ *  memchr()
+ *  memcpy()
+ *  strerror()
+ *  strlen()
+ *
+ * <sys/ioctl.h>
+ *  ioctl()
+ *
+ * <sys/stat.h>
+ *  struct stat
+ *  stat()
+ *
+ * <sys/syscall.h>
+ *  SYS_getdents64
+ *
+ * <unistd.h>
+ *  close()
+ *  syscall()
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <linux/fiemap.h>
+#  include <linux/fs.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#endif
+
+/*
+ * <utils/ifjmp.h>
+ *  ifjmp()
+ */
+#include <utils/ifjmp.h>
+
+#include "fs.h"
+
+/***********************************************************
+ * read order
+ **********************************************************/
+
+/**
+ * @brief Where a file lives on disk
+ */
+struct _fs_loc {
+    /** Device the file lives on */
+    dev_t dev;
+    /** Physical offset of the first extent, `0` if unknown */
+    uint64_t phys;
+    /** Inode number */
+    ino_t ino;
+    /** Index of the file in the input */
+    size_t idx;
+};
+
+/**
+ * @brief Get the physical offset of the first extent of @a path
+ * @param path The file
+ * @returns The physical offset, in bytes, or `0` if it's unknown
+ *     (no `FIEMAP` support, empty or inline file, ...)
+ */
+static uint64_t _fs_phys (const char * path)
+{
+    uint64_t ret = 0;
+
+#ifdef FS_IOC_FIEMAP
+    int fd = open(path, O_RDONLY);
+    ifjmp(fd < 0, out);
+
+    /* room for a single extent */
+    union {
+        struct fiemap fm;
+        char buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    } u = {0};
+
+    u.fm.fm_start = 0;
+    u.fm.fm_length = FIEMAP_MAX_OFFSET;
+    u.fm.fm_extent_count = 1;
+
+    if (ioctl(fd, FS_IOC_FIEMAP, &u.fm) == 0 && u.fm.fm_mapped_extents > 0)
+        ret = u.fm.fm_extents[0].fe_physical;
+
+    close(fd);
+out:
+#else
+    (void) path;
+#endif
+
+    return ret;
+}
+
+static int _fs_loc_cmp (const void * _l, const void * _r)
+{
+    const struct _fs_loc * l = _l;
+    const struct _fs_loc * r = _r;
+
+#define cmp(f) if (l->f != r->f) return (l->f < r->f) ? -1 : 1
+    cmp(dev);
+    cmp(phys);
+    cmp(ino);
+    cmp(idx);
+#undef cmp
+
+    return 0;
+}
+
+size_t * fs_order (char * const * paths, size_t n, enum fs_order order)
+{
+    size_t * ret = NULL;
+    struct _fs_loc * locs = NULL;
+
+    ifjmp(paths == NULL, out);
+
+    ret = malloc(n * sizeof(size_t));
+    ifjmp(ret == NULL, out);
+
+    if (order == FS_ORDER_ARGS) {
+        for (size_t i = 0; i < n; i++)
+            ret[i] = i;
+        goto out;
+    }
+
+    locs = calloc(n, sizeof(struct _fs_loc));
+    ifjmp(locs == NULL, ko);
+
+    for (size_t i = 0; i < n; i++) {
+        struct stat st = {0};
+
+        /* files that can't be `stat()`ed go first, and fail later */
+        if (stat(paths[i], &st) == 0) {
+            locs[i].dev = st.st_dev;
+            locs[i].ino = st.st_ino;
+        }
+
+        if (order == FS_ORDER_EXTENT && S_ISREG(st.st_mode))
+            locs[i].phys = _fs_phys(paths[i]);
+
+        locs[i].idx = i;
+    }
+
+    qsort(locs, n, sizeof(struct _fs_loc), _fs_loc_cmp);
+
+    for (size_t i = 0; i < n; i++)
+        ret[i] = locs[i].idx;
+
+out:
+    free(locs);
+    return ret;
+
+ko:
+    free(ret);
+    ret = NULL;
+    goto out;
+}
+
+/***********************************************************
+ * paths
+ **********************************************************/
+
+/**
+ * @brief Make room for at least @a n more paths in @a self
+ * @param self The list of paths
+ * @param n Number of paths to make room for
+ * @returns `true` if there's room, `false` otherwise
+ */
+static bool _fs_paths_reserve (struct fs_paths * self, size_t n)
+{
+    if (self->cap - self->n >= n)
+        return true;
+
+    size_t cap = (self->cap == 0) ? 64 : self->cap;
+    while (cap - self->n < n)
+        cap *= 2;
+
+    char ** v = realloc(self->v, cap * sizeof(char *));
+    if (v == NULL)
+        return false;
+
+    self->v = v;
+    self->cap = cap;
+    return true;
+}
+
+bool fs_paths_push (struct fs_paths * self, const char * path, size_t len)
+{
+    if (self == NULL || path == NULL || !_fs_paths_reserve(self, 1))
+        return false;
+
+    char * copy = arena_strndup(&self->arena, path, len);
+    if (copy == NULL)
+        return false;
+
+    self->v[self->n++] = copy;
+    return true;
+}
+
+/**
+ * @brief Append @a len bytes of @a str to the buffer @a buf
+ * @param buf The buffer
+ * @param blen Length of @a buf, in bytes
+ * @param bcap Capacity of @a buf, in bytes
+ * @param str What to append
+ * @param len Length of @a str, in bytes
+ * @returns `true` if @a str was appended, `false` otherwise
+ */
+static bool _fs_buf_append (char ** buf, size_t * blen, size_t * bcap, const char * str, size_t len)
+{
+    if (len == 0)
+        return true;
+
+    if (*bcap - *blen < len) {
+        size_t cap = (*blen + len) * 2;
+        char * tmp = realloc(*buf, cap);
+        if (tmp == NULL)
+            return false;
+
+        *buf = tmp;
+        *bcap = cap;
+    }
+
+    memcpy(*buf + *blen, str, len);
+    *blen += len;
+    return true;
+}
+
+bool fs_paths_read (struct fs_paths * self, Stream * in)
+{
+    bool ret = false;
+    char buf[1 << 16];
+
+    /* a path split between two reads */
+    char * part = NULL;
+    size_t plen = 0;
+    size_t pcap = 0;
+
+    ifjmp(self == NULL, out);
+    ifjmp(in == NULL, out);
+
+    ret = true;
+
+    for (size_t r = 0; ret && (r = stream_read(in, buf, 1, sizeof(buf))) > 0; ) {
+        char * p = buf;
+        char * end = buf + r;
+        char * nul = NULL;
+
+        while (ret && (nul = memchr(p, '\0', (size_t) (end - p))) != NULL) {
+            size_t len = (size_t) (nul - p);
+
+            if (plen > 0) { /* finish the split path */
+                ret = _fs_buf_append(&part, &plen, &pcap, p, len)
+                    && fs_paths_push(self, part, plen);
+                plen = 0;
+            } else if (len > 0) {
+                ret = fs_paths_push(self, p, len);
+            }
+
+            p = nul + 1;
+        }
+
+        /* keep the rest for the next read */
+        if (ret)
+            ret = _fs_buf_append(&part, &plen, &pcap, p, (size_t) (end - p));
+    }
+
+    if (ret && plen > 0)
+        ret = fs_paths_push(self, part, plen);
+
+out:
+    free(part);
+    return ret;
+}
+
+/**
+ * @brief Move every path of @a other to the end of @a self
+ * @param self The list of paths
+ * @param other Another list of paths, empty afterwards
+ * @returns `true` if every path was moved, `false` otherwise
+ */
+static bool _fs_paths_merge (struct fs_paths * self, struct fs_paths * other)
+{
+    /* the strings are moved even if the pointers can't be */
+    arena_merge(&self->arena, &other->arena);
+
+    /* a walk that found nothing may have no pointers at all */
+    bool ret = other->n == 0 || _fs_paths_reserve(self, other->n);
+    if (ret && other->n > 0) {
+        memcpy(self->v + self->n, other->v, other->n * sizeof(char *));
+        self->n += other->n;
+    }
+
+    free(other->v);
+    *other = (struct fs_paths) {0};
+    return ret;
+}
+
+void fs_paths_free (struct fs_paths * self)
+{
+    if (self == NULL)
+        return;
+
+    free(self->v);
+    arena_free(&self->arena);
+    *self = (struct fs_paths) {0};
+}
+
+/***********************************************************
+ * directory walk
+ **********************************************************/
+
+/**
+ * @brief Maximum number of directories kept open while waiting to be
+ *     walked; the rest are opened by path when their turn comes
+ */
+#define FS_WALK_MAX_FDS 256
+
+/**
+ * @brief A directory waiting to be walked
+ */
+struct _fs_dir {
+    /** The next directory waiting */
+    struct _fs_dir * next;
+    /** The open directory, or `-1` if it has to be opened by path */
+    int fd;
+    /** Length of `path`, in bytes */
+    size_t len;
+    /** Path of the directory */
+    char * path;
+};
+
+/**
+ * @brief State shared by the threads of a walk
+ */
+struct _fs_walk {
+    /** Protects everything below */
+    pthread_mutex_t lock;
+    /** Signaled when `pending` or `busy` change */
+    pthread_cond_t cond;
+    /** Directories waiting to be walked */
+    struct _fs_dir * pending;
+    /** Number of `pending` directories that are open */
+    size_t nfds;
+    /** Number of threads walking a directory */
+    unsigned busy;
+};
+
+/**
+ * @brief A thread of a walk
+ */
+struct _fs_worker {
+    /** The walk */
+    struct _fs_walk * walk;
+    /** Files found by this thread (also holds `_fs_dir`s) */
+    struct fs_paths files;
+    /** Directories found by this thread, not yet `pending` */
+    struct _fs_dir * found;
+    /** The thread */
+    pthread_t thread;
+    /** `false` if some directory couldn't be read */
+    bool ok;
+};
+
+/**
+ * @brief Join @a dir and @a name as `DIR/NAME`
+ * @param arena Where to allocate the result
+ * @param dir The directory
+ * @param name The name of the entry
+ * @param nlen Length of @a name, in bytes
+ * @param len Where to save the length of the result
+ * @returns The joined path, or `NULL` if an error occurred
+ */
+static char * _fs_join (Arena * arena, const struct _fs_dir * dir, const char * name, size_t nlen, size_t * len)
+{
+    size_t dlen = dir->len;
+    bool sep = dlen > 0 && dir->path[dlen - 1] != '/';
+
+    *len = dlen + sep + nlen;
+    char * ret = arena_alloc(arena, *len + 1);
+    if (ret != NULL) {
+        memcpy(ret, dir->path, dlen);
+        ret[dlen] = '/';
+        memcpy(ret + dlen + sep, name, nlen);
+        ret[*len] = '\0';
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Open the subdirectory @a name of @a dfd, if the walk can
+ *     still keep more directories open
+ * @param walk The walk
+ * @param dfd The open parent directory
+ * @param name The name of the subdirectory
+ * @returns The open subdirectory, or `-1`
+ */
+static int _fs_walk_opendir (struct _fs_walk * walk, int dfd, const char * name)
+{
+    pthread_mutex_lock(&walk->lock);
+    bool room = walk->nfds < FS_WALK_MAX_FDS;
+    if (room)
+        walk->nfds++;
+    pthread_mutex_unlock(&walk->lock);
+
+    if (!room)
+        return -1;
+
+    int fd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        pthread_mutex_lock(&walk->lock);
+        walk->nfds--;
+        pthread_mutex_unlock(&walk->lock);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Handle the entry @a name, of type @a type, of @a dir
+ * @param self The thread
+ * @param dir The directory
+ * @param dfd The open directory
+ * @param name The name of the entry
+ * @param type The type of the entry (`DT_*`)
+ */
+static void _fs_walk_entry (struct _fs_worker * self, const struct _fs_dir * dir, int dfd, const char * name, unsigned char type)
+{
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+        return;
+
+    struct stat st = {0};
+
+    /* symbolic links to regular files are archived as regular files */
+    if (type == DT_UNKNOWN && fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+        type = S_ISREG(st.st_mode) ? DT_REG :
+            S_ISDIR(st.st_mode) ? DT_DIR :
+            S_ISLNK(st.st_mode) ? DT_LNK :
+            DT_UNKNOWN ;
+
+    if (type == DT_LNK)
+        type = (fstatat(dfd, name, &st, 0) == 0 && S_ISREG(st.st_mode)) ?
+            DT_REG :
+            DT_UNKNOWN ;
+
+    if (type != DT_REG && type != DT_DIR)
+        return;
+
+    size_t len = 0;
+    char * path = _fs_join(&self->files.arena, dir, name, strlen(name), &len);
+    ifjmp(path == NULL, ko);
+
+    if (type == DT_REG) {
+        ifjmp(!_fs_paths_reserve(&self->files, 1), ko);
+        self->files.v[self->files.n++] = path;
+    } else {
+        struct _fs_dir * sub = arena_alloc(&self->files.arena, sizeof(struct _fs_dir));
+        ifjmp(sub == NULL, ko);
+
+        sub->fd = _fs_walk_opendir(self->walk, dfd, name);
+        sub->len = len;
+        sub->path = path;
+        sub->next = self->found;
+        self->found = sub;
+    }
+
+    return;
+
+ko:
+    fprintf(stderr, "Could not keep `%s`: %s\n", name, strerror(errno));
+    self->ok = false;
+}
+
+/**
+ * @brief Walk the entries of @a dir
+ * @param self The thread
+ * @param dir The directory
+ */
+static void _fs_walk_dir (struct _fs_worker * self, struct _fs_dir * dir)
+{
+    int fd = (dir->fd >= 0) ?
+        dir->fd :
+        open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) ;
+    ifjmp(fd < 0, ko);
+
+#ifdef SYS_getdents64
+    /* the layout `getdents64()` fills `buf` with */
+    struct _fs_dirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    _Alignas(struct _fs_dirent64) char buf[1 << 15];
+
+    long nread = 0;
+    while ((nread = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+        for (long off = 0; off < nread; ) {
+            struct _fs_dirent64 * e = (void *) (buf + off);
+            _fs_walk_entry(self, dir, fd, e->d_name, e->d_type);
+            off += e->d_reclen;
+        }
+    }
+
+    int err = errno;
+    close(fd);
+    errno = err;
+#else
+    DIR * d = fdopendir(fd);
+    if (d == NULL) {
+        close(fd);
+        goto ko;
+    }
+
+    int nread = 0;
+    struct dirent * e = NULL;
+    for (errno = 0; (e = readdir(d)) != NULL; errno = 0)
+        _fs_walk_entry(self, dir, fd, e->d_name, e->d_type);
+
+    nread = (errno != 0) ? -1 : 0;
+    closedir(d);
+#endif
+
+    if (dir->fd >= 0) {
+        pthread_mutex_lock(&self->walk->lock);
+        self->walk->nfds--;
+        pthread_mutex_unlock(&self->walk->lock);
+    }
+
+    ifjmp(nread < 0, ko);
+    return;
+
+ko:
+    fprintf(stderr, "Could not read `%s`: %s\n", dir->path, strerror(errno));
+    self->ok = false;
+}
+
+/**
+ * @brief Walk directories until there are none left
+ * @param arg The thread (`struct _fs_worker *`)
+ * @returns `NULL`
+ */
+static void * _fs_walk_worker (void * arg)
+{
+    struct _fs_worker * self = arg;
+    struct _fs_walk * walk = self->walk;
+
+    pthread_mutex_lock(&walk->lock);
+
+    for (;;) {
+        /* nothing to do, but others may still find more directories */
+        while (walk->pending == NULL && walk->busy > 0)
+            pthread_cond_wait(&walk->cond, &walk->lock);
+
+        if (walk->pending == NULL)
+            break;
+
+        struct _fs_dir * dir = walk->pending;
+        walk->pending = dir->next;
+        walk->busy++;
+
+        pthread_mutex_unlock(&walk->lock);
+        _fs_walk_dir(self, dir);
+        pthread_mutex_lock(&walk->lock);
+
+        while (self->found != NULL) {
+            struct _fs_dir * sub = self->found;
+            self->found = sub->next;
+            sub->next = walk->pending;
+            walk->pending = sub;
+        }
+
+        walk->busy--;
+        pthread_cond_broadcast(&walk->cond);
+    }
+
+    pthread_mutex_unlock(&walk->lock);
+    return NULL;
+}
+
+bool fs_walk (struct fs_paths * self, const char * root, unsigned nthreads)
+{
+    bool ret = false;
+    struct _fs_worker * workers = NULL;
+    struct _fs_walk walk = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+
+    ifjmp(self == NULL, out);
+    ifjmp(root == NULL, out);
+
+    if (nthreads == 0)
+        nthreads = 1;
+
+    workers = calloc(nthreads, sizeof(struct _fs_worker));
+    ifjmp(workers == NULL, out);
+
+    for (unsigned i = 0; i < nthreads; i++) {
+        workers[i].walk = &walk;
+        workers[i].ok = true;
+    }
+
+    { /* the root is the first pending directory */
+        struct _fs_dir * dir = arena_alloc(&workers->files.arena, sizeof(struct _fs_dir));
+        ifjmp(dir == NULL, out);
+
+        dir->len = strlen(root);
+        dir->path = arena_strndup(&workers->files.arena, root, dir->len);
+        ifjmp(dir->path == NULL, out);
+
+        dir->fd = -1;
+        dir->next = NULL;
+        walk.pending = dir;
+    }
+
+    /* if a thread can't be created, walk with fewer */
+    unsigned nstarted = 1;
+    while (nstarted < nthreads
+            && pthread_create(&workers[nstarted].thread, NULL,
+                _fs_walk_worker, workers + nstarted) == 0)
+        nstarted++;
+
+    _fs_walk_worker(workers);
+
+    for (unsigned i = 1; i < nstarted; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    ret = true;
+    for (unsigned i = 0; i < nstarted; i++)
+        ret = _fs_paths_merge(self, &workers[i].files)
+            && workers[i].ok
+            && ret;
+
+out:
+    if (workers != NULL)
+        for (unsigned i = 0; i < nthreads; i++)
+            fs_paths_free(&workers[i].files);
+    free(workers);
+    return ret;
+}
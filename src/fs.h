@@ -0,0 +1,100 @@
+#ifndef _FS_H
+#define _FS_H
+
+/*
+ * <stdbool.h>
+ *  bool
+ *
+ * <stdlib.h>
+ *  size_t
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * <arena.h>
+ *  Arena
+ *
+ * <stream.h>
+ *  Stream
+ */
+#include "arena.h"
+#include "stream.h"
+
+/**
+ * @brief A list of paths
+ */
+struct fs_paths {
+    /** The paths */
+    char ** v;
+    /** Number of paths */
+    size_t n;
+    /** Number of paths `v` has room for */
+    size_t cap;
+    /** Where the path strings live */
+    Arena arena;
+};
+
+/**
+ * @brief Order in which to read a set of input files
+ */
+enum fs_order {
+    /** The order they were given in */
+    FS_ORDER_ARGS,
+    /** Ascending inode number, per device */
+    FS_ORDER_INODE,
+    /** Ascending physical offset of the first extent, per device
+     *  (`FIEMAP`), falling back to the inode number */
+    FS_ORDER_EXTENT,
+};
+
+/**
+ * @brief Compute the order in which to read @a paths so that reading
+ *     them in sequence seeks as little as possible
+ * @param paths The files to read
+ * @param n Number of elements of @a paths
+ * @param order How to order @a paths
+ * @returns An array (to be `free()`d) with the @a n indices of @a paths
+ *     in the order they should be read, or `NULL` if an error occurred
+ */
+size_t * fs_order (char * const * paths, size_t n, enum fs_order order);
+
+/**
+ * @brief Append a copy of @a path to @a self
+ * @param self The list of paths
+ * @param path The path to append
+ * @param len Length of @a path, in bytes
+ * @returns `true` if @a path was appended, `false` otherwise
+ */
+bool fs_paths_push (struct fs_paths * self, const char * path, size_t len);
+
+/**
+ * @brief Append the `NULL` separated paths read from @a in to @a self
+ * @param self The list of paths
+ * @param in A Stream opened with the "rb" mode
+ * @returns `true` if every path read was appended, `false` otherwise
+ *
+ * Empty paths are skipped, and the last path needn't be terminated.
+ */
+bool fs_paths_read (struct fs_paths * self, Stream * in);
+
+/**
+ * @brief Free @a self
+ * @param self The list of paths
+ */
+void fs_paths_free (struct fs_paths * self);
+
+/**
+ * @brief Append every file under the directory @a root to @a self
+ * @param self The list of paths
+ * @param root The directory to walk
+ * @param nthreads Number of threads to walk @a root with
+ * @returns `true` if every directory under @a root was read, `false`
+ *     otherwise (@a self still gets every file found)
+ *
+ * Regular files and symbolic links to regular files are appended, in
+ * no particular order; symbolic links to directories aren't followed.
+ */
+bool fs_walk (struct fs_paths * self, const char * root, unsigned nthreads);
+
+#endif /* _FS_H */
@@ -0,0 +1,339 @@
+/*
+ * <pthread.h>
+ *  PTHREAD_ONCE_INIT
+ *  pthread_once()
+ *  pthread_once_t
+ *
+ * <stdint.h>
+ *  uint32_t
+ *  uint64_t
+ *  uint8_t
+ *  uintptr_t
+ *
+ * <stdlib.h>
+ *  size_t
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * <cpuid.h>
+ *  __get_cpuid()
+ *  bit_SSE4_2
+ *
+ * <nmmintrin.h>
+ *  _mm_crc32_u64()
+ *  _mm_crc32_u8()
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#  define HASH_CRC_SSE42
+#  include <cpuid.h>
+#  include <nmmintrin.h>
+#endif
+
+/*
+ * <arm_acle.h>
+ *  __crc32cb()
+ *  __crc32cd()
+ */
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#  define HASH_CRC_ARMV8
+#  include <arm_acle.h>
+#endif
+
+#include "hash.h"
+
+/*
+ * XXH64, from the specification at
+ * https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ */
+
+#define P1 UINT64_C(0x9E3779B185EBCA87)
+#define P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define P3 UINT64_C(0x165667B19E3779F9)
+#define P4 UINT64_C(0x85EBCA77C2B2AE63)
+#define P5 UINT64_C(0x27D4EB2F165667C5)
+
+static inline uint64_t _hash_rotl (uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* little endian loads, whatever the host (compilers make these a single load) */
+static inline uint64_t _hash_read64 (const uint8_t * p)
+{
+    return (uint64_t) p[0]       | (uint64_t) p[1] << 8
+        | (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24
+        | (uint64_t) p[4] << 32 | (uint64_t) p[5] << 40
+        | (uint64_t) p[6] << 48 | (uint64_t) p[7] << 56;
+}
+
+static inline uint32_t _hash_read32 (const uint8_t * p)
+{
+    return (uint32_t) p[0]       | (uint32_t) p[1] << 8
+        | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline uint64_t _hash_round (uint64_t acc, uint64_t in)
+{
+    acc += in * P2;
+    acc = _hash_rotl(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t _hash_merge (uint64_t acc, uint64_t val)
+{
+    acc ^= _hash_round(0, val);
+    return acc * P1 + P4;
+}
+
+uint64_t hash64 (const void * data, size_t size, uint64_t seed)
+{
+    const uint8_t * p = data;
+    const uint8_t * end = p + size;
+    uint64_t h = 0;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + P1 + P2;
+        uint64_t v2 = seed + P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - P1;
+
+        for (; end - p >= 32; p += 32) {
+            v1 = _hash_round(v1, _hash_read64(p));
+            v2 = _hash_round(v2, _hash_read64(p + 8));
+            v3 = _hash_round(v3, _hash_read64(p + 16));
+            v4 = _hash_round(v4, _hash_read64(p + 24));
+        }
+
+        h = _hash_rotl(v1, 1) + _hash_rotl(v2, 7)
+            + _hash_rotl(v3, 12) + _hash_rotl(v4, 18);
+        h = _hash_merge(h, v1);
+        h = _hash_merge(h, v2);
+        h = _hash_merge(h, v3);
+        h = _hash_merge(h, v4);
+    } else {
+        h = seed + P5;
+    }
+
+    h += (uint64_t) size;
+
+    for (; end - p >= 8; p += 8) {
+        h ^= _hash_round(0, _hash_read64(p));
+        h = _hash_rotl(h, 27) * P1 + P4;
+    }
+
+    if (end - p >= 4) {
+        h ^= (uint64_t) _hash_read32(p) * P1;
+        h = _hash_rotl(h, 23) * P2 + P3;
+        p += 4;
+    }
+
+    for (; p < end; p++) {
+        h ^= (uint64_t) *p * P5;
+        h = _hash_rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+/*
+ * CRC32C (Castagnoli), reflected, as in iSCSI and ext4: with the CRC
+ * instructions of SSE4.2 or ARMv8 if there are any, else sliced by 8
+ * with tables.
+ */
+
+#define CRC32C_POLY UINT32_C(0x82F63B78)
+
+/** `_hash_crc_table[k][b]` is the CRC of byte `b` followed by `k` zeros */
+static uint32_t _hash_crc_table[8][256];
+
+/** CRC of some data, without the inversions at the start and end */
+typedef uint32_t (* _hash_crc_fn) (uint32_t crc, const uint8_t * p, size_t size);
+
+/*
+ * The CRC instructions take a few cycles each, but a new one can start
+ * every cycle: three pieces of the data, one after the other, are
+ * CRC'ed at the same time, and their CRCs combined, as in zlib's
+ * `crc32_combine()`.
+ */
+
+/** Size of each of the three pieces CRC'ed at the same time, in bytes */
+#define CRC32C_LANE (1 << 12)
+
+/** `x^(2^k)` modulo the polynomial */
+static uint32_t _hash_crc_x2n[32];
+
+/** `x^(8 * CRC32C_LANE)` and `x^(16 * CRC32C_LANE)` modulo the polynomial */
+static uint32_t _hash_crc_lane[2];
+
+/* `a * b` modulo the polynomial */
+static uint32_t _hash_crc_mult (uint32_t a, uint32_t b)
+{
+    uint32_t m = UINT32_C(1) << 31;
+    uint32_t p = 0;
+
+    for (; m != 0; m >>= 1) {
+        if (a & m)
+            p ^= b;
+        b = (b >> 1) ^ ((b & 1) ? CRC32C_POLY : 0);
+    }
+
+    return p;
+}
+
+/* `x^(8 * n)` modulo the polynomial, what shifts a CRC by `n` bytes */
+static uint32_t _hash_crc_xpow8n (size_t n)
+{
+    uint32_t p = UINT32_C(1) << 31;
+
+    for (unsigned k = 3; n > 0; n >>= 1, k++)
+        if (n & 1)
+            p = _hash_crc_mult(_hash_crc_x2n[k & 31], p);
+
+    return p;
+}
+
+static uint32_t _hash_crc32c_sw (uint32_t crc, const uint8_t * p, size_t size)
+{
+    for (; size > 0 && ((uintptr_t) p & 7) != 0; size--)
+        crc = _hash_crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t lo = crc ^ _hash_read32(p);
+        uint32_t hi = _hash_read32(p + 4);
+        crc = _hash_crc_table[7][lo & 0xFF]
+            ^ _hash_crc_table[6][(lo >> 8) & 0xFF]
+            ^ _hash_crc_table[5][(lo >> 16) & 0xFF]
+            ^ _hash_crc_table[4][lo >> 24]
+            ^ _hash_crc_table[3][hi & 0xFF]
+            ^ _hash_crc_table[2][(hi >> 8) & 0xFF]
+            ^ _hash_crc_table[1][(hi >> 16) & 0xFF]
+            ^ _hash_crc_table[0][hi >> 24];
+    }
+
+    for (; size > 0; size--)
+        crc = _hash_crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+#ifdef HASH_CRC_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t _hash_crc32c_hw (uint32_t crc, const uint8_t * p, size_t size)
+{
+    uint64_t c = crc;
+
+    for (; size > 0 && ((uintptr_t) p & 7) != 0; size--)
+        c = _mm_crc32_u8((uint32_t) c, *p++);
+
+    for (; size >= 3 * CRC32C_LANE; size -= 3 * CRC32C_LANE, p += 3 * CRC32C_LANE) {
+        uint64_t b = 0;
+        uint64_t d = 0;
+
+        for (size_t i = 0; i < CRC32C_LANE; i += 8) {
+            c = _mm_crc32_u64(c, _hash_read64(p + i));
+            b = _mm_crc32_u64(b, _hash_read64(p + CRC32C_LANE + i));
+            d = _mm_crc32_u64(d, _hash_read64(p + 2 * CRC32C_LANE + i));
+        }
+
+        c = _hash_crc_mult(_hash_crc_lane[1], (uint32_t) c)
+            ^ _hash_crc_mult(_hash_crc_lane[0], (uint32_t) b)
+            ^ d;
+    }
+
+    for (; size >= 8; size -= 8, p += 8)
+        c = _mm_crc32_u64(c, _hash_read64(p));
+
+    for (; size > 0; size--)
+        c = _mm_crc32_u8((uint32_t) c, *p++);
+
+    return (uint32_t) c;
+}
+#endif
+
+#ifdef HASH_CRC_ARMV8
+static uint32_t _hash_crc32c_hw (uint32_t crc, const uint8_t * p, size_t size)
+{
+    for (; size > 0 && ((uintptr_t) p & 7) != 0; size--)
+        crc = __crc32cb(crc, *p++);
+
+    for (; size >= 3 * CRC32C_LANE; size -= 3 * CRC32C_LANE, p += 3 * CRC32C_LANE) {
+        uint32_t b = 0;
+        uint32_t d = 0;
+
+        for (size_t i = 0; i < CRC32C_LANE; i += 8) {
+            crc = __crc32cd(crc, _hash_read64(p + i));
+            b = __crc32cd(b, _hash_read64(p + CRC32C_LANE + i));
+            d = __crc32cd(d, _hash_read64(p + 2 * CRC32C_LANE + i));
+        }
+
+        crc = _hash_crc_mult(_hash_crc_lane[1], crc)
+            ^ _hash_crc_mult(_hash_crc_lane[0], b)
+            ^ d;
+    }
+
+    for (; size >= 8; size -= 8, p += 8)
+        crc = __crc32cd(crc, _hash_read64(p));
+
+    for (; size > 0; size--)
+        crc = __crc32cb(crc, *p++);
+
+    return crc;
+}
+#endif
+
+static _hash_crc_fn _hash_crc32c = _hash_crc32c_sw;
+static pthread_once_t _hash_crc_once = PTHREAD_ONCE_INIT;
+
+/* fill the tables, and pick the instructions if the CPU has them */
+static void _hash_crc_init (void)
+{
+    _hash_crc_x2n[0] = UINT32_C(1) << 30;
+    for (int k = 1; k < 32; k++)
+        _hash_crc_x2n[k] = _hash_crc_mult(_hash_crc_x2n[k - 1], _hash_crc_x2n[k - 1]);
+
+    _hash_crc_lane[0] = _hash_crc_xpow8n(CRC32C_LANE);
+    _hash_crc_lane[1] = _hash_crc_xpow8n(2 * CRC32C_LANE);
+
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        _hash_crc_table[0][b] = crc;
+    }
+
+    for (int k = 1; k < 8; k++)
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t crc = _hash_crc_table[k - 1][b];
+            _hash_crc_table[k][b] = _hash_crc_table[0][crc & 0xFF] ^ (crc >> 8);
+        }
+
+#if defined(HASH_CRC_SSE42)
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2))
+        _hash_crc32c = _hash_crc32c_hw;
+#elif defined(HASH_CRC_ARMV8)
+    /* built for CPUs that have them */
+    _hash_crc32c = _hash_crc32c_hw;
+#endif
+}
+
+uint32_t crc32c (uint32_t crc, const void * data, size_t size)
+{
+    pthread_once(&_hash_crc_once, _hash_crc_init);
+    return ~_hash_crc32c(~crc, data, size);
+}
+
+uint32_t crc32c_combine (uint32_t crc1, uint32_t crc2, size_t size2)
+{
+    pthread_once(&_hash_crc_once, _hash_crc_init);
+    return _hash_crc_mult(_hash_crc_xpow8n(size2), crc1) ^ crc2;
+}
@@ -0,0 +1,51 @@
+#ifndef _HASH_H
+#define _HASH_H
+
+/*
+ * <stdint.h>
+ *  uint32_t
+ *  uint64_t
+ *
+ * <stdlib.h>
+ *  size_t
+ */
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @brief Hash @a size bytes of @a data (XXH64)
+ * @param data The data to hash
+ * @param size Size of @a data, in bytes
+ * @param seed Seed of the hash
+ * @returns The hash of @a data
+ *
+ * Fast, but not cryptographic: equal hashes mean the data is very
+ * likely, not certainly, equal.
+ */
+uint64_t hash64 (const void * data, size_t size, uint64_t seed);
+
+/**
+ * @brief Update @a crc, the CRC32C of some data, with @a size bytes of
+ *     @a data that follow it
+ * @param crc CRC32C of the data so far, `0` to start
+ * @param data The data that follows
+ * @param size Size of @a data, in bytes
+ * @returns The CRC32C of the data so far, and @a data
+ *
+ * Uses the CRC instructions of SSE4.2 or ARMv8, if the CPU has them.
+ */
+uint32_t crc32c (uint32_t crc, const void * data, size_t size);
+
+/**
+ * @brief Combine @a crc1 and @a crc2, the CRC32Cs of two pieces of
+ *     data, into the CRC32C of the pieces one after the other
+ * @param crc1 CRC32C of the first piece
+ * @param crc2 CRC32C of the second piece
+ * @param size2 Size of the second piece, in bytes
+ * @returns The CRC32C of both pieces, as `crc32c()` would make it
+ *
+ * Takes a few hundred cycles, whatever the size of the pieces.
+ */
+uint32_t crc32c_combine (uint32_t crc1, uint32_t crc2, size_t size2);
+
+#endif /* _HASH_H */
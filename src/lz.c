@@ -0,0 +1,363 @@
+/*
+ * <stdint.h>
+ *  uint32_t
+ *  uint8_t
+ *
+ * <stdlib.h>
+ *  size_t
+ *
+ * <string.h>
+ *  memcpy()
+ *  memset()
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz.h"
+
+/** Minimum length of a match */
+#define LZ_MINMATCH 4
+/** Maximum distance of a match */
+#define LZ_MAXOFFSET 65535
+/** The last bytes are always literals */
+#define LZ_LASTLITERALS 5
+/** Matches don't start in the last bytes */
+#define LZ_MFLIMIT 12
+/** Maximum number of bits of the hash of 4 bytes */
+#define LZ_HASH_BITS 14
+
+static inline uint32_t _lz_read32 (const uint8_t * p)
+{
+    uint32_t ret;
+    memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+static inline uint32_t _lz_hash (uint32_t v, unsigned bits)
+{
+    return (v * UINT32_C(2654435761)) >> (32 - bits);
+}
+
+/**
+ * @brief Write a length that doesn't fit in a token nibble
+ * @param op Where to write
+ * @param len What's left of the length, after the nibble's 15
+ * @returns Where to write next
+ */
+static uint8_t * _lz_write_len (uint8_t * op, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+/**
+ * @brief Write a sequence: @a nlit literals and a match
+ * @param op Where to write
+ * @param oend End of the output
+ * @param lit The literals
+ * @param nlit Number of literals
+ * @param offset Distance of the match
+ * @param mlen Length of the match, `0` for the last sequence
+ * @returns Where to write next, or `NULL` if there's no room
+ */
+static uint8_t * _lz_sequence (uint8_t * op, const uint8_t * oend, const uint8_t * lit, size_t nlit, size_t offset, size_t mlen)
+{
+    size_t need = 1 + nlit + nlit / 255 + 1;
+    if (mlen > 0)
+        need += 2 + (mlen - LZ_MINMATCH) / 255 + 1;
+    if ((size_t) (oend - op) < need)
+        return NULL;
+
+    uint8_t * token = op++;
+    *token = (uint8_t) (((nlit < 15) ? nlit : 15) << 4);
+    if (nlit >= 15)
+        op = _lz_write_len(op, nlit - 15);
+
+    memcpy(op, lit, nlit);
+    op += nlit;
+
+    if (mlen > 0) {
+        *op++ = (uint8_t) (offset & 0xFF);
+        *op++ = (uint8_t) (offset >> 8);
+
+        size_t m = mlen - LZ_MINMATCH;
+        *token |= (uint8_t) ((m < 15) ? m : 15);
+        if (m >= 15)
+            op = _lz_write_len(op, m - 15);
+    }
+
+    return op;
+}
+
+/**
+ * @brief The data to compress: a dictionary, if any, and right after
+ *     it the data itself; positions count from the dictionary's start
+ */
+struct _lz_in {
+    /** The dictionary */
+    const uint8_t * dict;
+    /** Size of the dictionary, in bytes */
+    size_t dsize;
+    /** The data */
+    const uint8_t * src;
+};
+
+static inline uint8_t _lz_at (const struct _lz_in * in, size_t pos)
+{
+    return (pos >= in->dsize) ?
+        in->src[pos - in->dsize] :
+        in->dict[pos] ;
+}
+
+static inline uint32_t _lz_vread32 (const struct _lz_in * in, size_t pos)
+{
+    if (pos >= in->dsize)
+        return _lz_read32(in->src + (pos - in->dsize));
+    if (pos + 4 <= in->dsize)
+        return _lz_read32(in->dict + pos);
+
+    /* across the end of the dictionary */
+    uint8_t buf[4];
+    for (size_t i = 0; i < 4; i++)
+        buf[i] = _lz_at(in, pos + i);
+    return _lz_read32(buf);
+}
+
+/**
+ * @brief Compress the data of @a in, from position `in->dsize` to
+ *     @a end, to @a dst
+ * @param in The data
+ * @param end Position of the end of the data
+ * @param dtable Positions of the 4 bytes sequences of the dictionary,
+ *     by hash, `NULL` if none
+ * @param dst Where to write the compressed data
+ * @param cap Size of @a dst, in bytes
+ * @returns Size of the compressed data, or `0` if it doesn't fit in @a cap
+ */
+static size_t _lz_compress (const struct _lz_in * in, size_t end, const uint32_t * dtable, uint8_t * dst, size_t cap)
+{
+    /* positions of the last 4 bytes seen with each hash */
+    static _Thread_local uint32_t table[1 << LZ_HASH_BITS];
+
+    size_t ip = in->dsize;
+    size_t anchor = ip;
+    size_t size = end - ip;
+    uint8_t * op = dst;
+    const uint8_t * oend = op + cap;
+
+    if (size > LZ_MFLIMIT) {
+        /* small inputs only need (and clear) part of the table */
+        unsigned bits = 8;
+        for (; bits < LZ_HASH_BITS && ((size_t) 1 << bits) < size; bits++)
+            ;
+        memset(table, 0, sizeof(uint32_t) << bits);
+
+        /* the first position has nothing before it to match */
+        if (dtable == NULL)
+            ip++;
+
+        size_t mflimit = end - LZ_MFLIMIT;
+        size_t matchlimit = end - LZ_LASTLITERALS;
+        size_t misses = 0;
+
+        while (ip < mflimit) {
+            uint32_t seq = _lz_vread32(in, ip);
+            uint32_t h = _lz_hash(seq, bits);
+            size_t match = table[h];
+            table[h] = (uint32_t) ip;
+
+            /* nothing in the data itself, maybe in the dictionary */
+            if (dtable != NULL
+                    && (match >= ip
+                        || ip - match > LZ_MAXOFFSET
+                        || _lz_vread32(in, match) != seq))
+                match = dtable[_lz_hash(seq, LZ_HASH_BITS)];
+
+            if (match >= ip
+                    || ip - match > LZ_MAXOFFSET
+                    || _lz_vread32(in, match) != seq) {
+                /* skip faster through data that doesn't compress */
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+
+            misses = 0;
+
+            while (ip > anchor && match > 0 && _lz_at(in, ip - 1) == _lz_at(in, match - 1)) {
+                ip--;
+                match--;
+            }
+
+            size_t mend = ip + LZ_MINMATCH;
+            size_t m = match + LZ_MINMATCH;
+            while (mend < matchlimit && _lz_at(in, mend) == _lz_at(in, m)) {
+                mend++;
+                m++;
+            }
+
+            op = _lz_sequence(op, oend, in->src + (anchor - in->dsize), ip - anchor,
+                    ip - match, mend - ip);
+            if (op == NULL)
+                return 0;
+
+            ip = anchor = mend;
+        }
+    }
+
+    op = _lz_sequence(op, oend, in->src + (anchor - in->dsize), end - anchor, 0, 0);
+    return (op != NULL) ?
+        (size_t) (op - dst) :
+        0 ;
+}
+
+size_t lz_compress (const void * src, size_t size, void * dst, size_t cap)
+{
+    if (src == NULL || dst == NULL || size > UINT32_MAX)
+        return 0;
+
+    struct _lz_in in = { .src = src };
+    return _lz_compress(&in, size, NULL, dst, cap);
+}
+
+bool lz_dict_init (LzDict * self, const void * data, size_t size)
+{
+    if (self == NULL || data == NULL)
+        return false;
+
+    /* matches never go further back */
+    if (size > LZ_MAXOFFSET) {
+        data = (const uint8_t *) data + (size - LZ_MAXOFFSET);
+        size = LZ_MAXOFFSET;
+    }
+
+    self->table = malloc(sizeof(uint32_t) << LZ_HASH_BITS);
+    if (self->table == NULL)
+        return false;
+
+    self->data = data;
+    self->size = size;
+
+    /* later positions win, they're closer to the data */
+    memset(self->table, 0, sizeof(uint32_t) << LZ_HASH_BITS);
+    for (size_t pos = 0; pos + 4 <= size; pos++)
+        self->table[_lz_hash(_lz_read32(self->data + pos), LZ_HASH_BITS)] = (uint32_t) pos;
+
+    return true;
+}
+
+void lz_dict_free (LzDict * self)
+{
+    if (self == NULL)
+        return;
+
+    free(self->table);
+    self->table = NULL;
+}
+
+size_t lz_compress_dict (const LzDict * dict, const void * src, size_t size, void * dst, size_t cap)
+{
+    if (dict == NULL || dict->table == NULL || src == NULL || dst == NULL || size > UINT32_MAX)
+        return 0;
+
+    struct _lz_in in = { .dict = dict->data, .dsize = dict->size, .src = src };
+    return _lz_compress(&in, dict->size + size, dict->table, dst, cap);
+}
+
+/**
+ * @brief Read a length that doesn't fit in a token nibble
+ * @param ip Where to read from, updated
+ * @param iend End of the input
+ * @param len The length, added to
+ * @returns `true` if the length was read, `false` otherwise
+ */
+static bool _lz_read_len (const uint8_t ** ip, const uint8_t * iend, size_t * len)
+{
+    uint8_t b = 0;
+
+    do {
+        if (*ip >= iend)
+            return false;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+
+    return true;
+}
+
+bool lz_decompress_dict (const void * dict, size_t dictsize, const void * src, size_t size, void * dst, size_t dsize)
+{
+    const uint8_t * ip = src;
+    const uint8_t * iend = ip + size;
+    uint8_t * op = dst;
+    uint8_t * oend = op + dsize;
+
+    if (src == NULL || dst == NULL || (dict == NULL && dictsize > 0))
+        return false;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t nlit = token >> 4;
+        if (nlit == 15 && !_lz_read_len(&ip, iend, &nlit))
+            return false;
+
+        if (nlit > (size_t) (iend - ip) || nlit > (size_t) (oend - op))
+            return false;
+
+        memcpy(op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+
+        /* the last sequence has no match */
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+
+        size_t offset = (size_t) ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+
+        size_t have = (size_t) (op - (uint8_t *) dst);
+        if (offset == 0 || offset > have + dictsize)
+            return false;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && !_lz_read_len(&ip, iend, &mlen))
+            return false;
+        mlen += LZ_MINMATCH;
+
+        if (mlen > (size_t) (oend - op))
+            return false;
+
+        /* the start of the match may be in the dictionary */
+        if (offset > have) {
+            size_t back = offset - have;
+            size_t n = (mlen < back) ? mlen : back;
+            memcpy(op, (const uint8_t *) dict + (dictsize - back), n);
+            op += n;
+            mlen -= n;
+            offset = (size_t) (op - (uint8_t *) dst);
+        }
+
+        /* matches may overlap what they write */
+        const uint8_t * match = op - offset;
+        if (offset >= mlen) {
+            memcpy(op, match, mlen);
+            op += mlen;
+        } else {
+            while (mlen-- > 0)
+                *op++ = *match++;
+        }
+    }
+
+    return op == oend;
+}
+
+bool lz_decompress (const void * src, size_t size, void * dst, size_t dsize)
+{
+    return lz_decompress_dict(NULL, 0, src, size, dst, dsize);
+}
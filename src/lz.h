@@ -0,0 +1,103 @@
+#ifndef _LZ_H
+#define _LZ_H
+
+/*
+ * <stdbool.h>
+ *  bool
+ *
+ * <stdint.h>
+ *  uint32_t
+ *  uint8_t
+ *
+ * <stdlib.h>
+ *  size_t
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * A small LZ77 codec, writing the LZ4 block format: sequences of
+ * literals followed by a match of at least 4 bytes, at most 64 KiB
+ * back. Fast, rather than compact.
+ */
+
+/**
+ * @brief A dictionary to compress with: data matches can refer to, as
+ *     if it came right before the data to compress
+ */
+typedef struct {
+    /** The dictionary (only its last 64 KiB, that matches can reach) */
+    const uint8_t * data;
+    /** Size of `data`, in bytes */
+    size_t size;
+    /** Positions of the 4 bytes sequences of `data`, by hash */
+    uint32_t * table;
+} LzDict;
+
+/**
+ * @brief Compress @a size bytes of @a src to @a dst
+ * @param src The data to compress
+ * @param size Size of @a src, in bytes
+ * @param dst Where to write the compressed data
+ * @param cap Size of @a dst, in bytes
+ * @returns Size of the compressed data, or `0` if it doesn't fit in @a cap
+ *
+ * The output is always the same for the same input.
+ */
+size_t lz_compress (const void * src, size_t size, void * dst, size_t cap);
+
+/**
+ * @brief Get @a self ready to compress with @a data as the dictionary
+ * @param self The dictionary
+ * @param data The dictionary's data, kept (not copied) until `lz_dict_free()`
+ * @param size Size of @a data, in bytes
+ * @returns `true` if @a self is ready, `false` otherwise
+ */
+bool lz_dict_init (LzDict * self, const void * data, size_t size);
+
+/**
+ * @brief Free what `lz_dict_init()` allocated for @a self
+ * @param self The dictionary
+ */
+void lz_dict_free (LzDict * self);
+
+/**
+ * @brief Compress @a size bytes of @a src to @a dst, against @a dict
+ * @param dict The dictionary
+ * @param src The data to compress
+ * @param size Size of @a src, in bytes
+ * @param dst Where to write the compressed data
+ * @param cap Size of @a dst, in bytes
+ * @returns Size of the compressed data, or `0` if it doesn't fit in @a cap
+ *
+ * Decompress with `lz_decompress_dict()` and the same dictionary.
+ */
+size_t lz_compress_dict (const LzDict * dict, const void * src, size_t size, void * dst, size_t cap);
+
+/**
+ * @brief Decompress @a size bytes of @a src to exactly @a dsize bytes of @a dst
+ * @param src The compressed data
+ * @param size Size of @a src, in bytes
+ * @param dst Where to write the decompressed data
+ * @param dsize Size of the decompressed data, in bytes
+ * @returns `true` if @a src decompressed to exactly @a dsize bytes,
+ *     `false` if it's corrupt
+ */
+bool lz_decompress (const void * src, size_t size, void * dst, size_t dsize);
+
+/**
+ * @brief Decompress @a size bytes of @a src, compressed against the
+ *     dictionary @a dict, to exactly @a dsize bytes of @a dst
+ * @param dict The dictionary's data
+ * @param dictsize Size of @a dict, in bytes
+ * @param src The compressed data
+ * @param size Size of @a src, in bytes
+ * @param dst Where to write the decompressed data
+ * @param dsize Size of the decompressed data, in bytes
+ * @returns `true` if @a src decompressed to exactly @a dsize bytes,
+ *     `false` if it's corrupt
+ */
+bool lz_decompress_dict (const void * dict, size_t dictsize, const void * src, size_t size, void * dst, size_t dsize);
+
+#endif /* _LZ_H */
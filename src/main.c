@@ -1,36 +1,84 @@
 /*
  * <errno.h>
+ *  ENOENT
  *  errno
  *  strerror()
  *
+ * <getopt.h>
+ *  getopt_long()
+ *  optarg
+ *  optind
+ *  struct option
+ *
  * <inttypes.h>
+ *  PRIu32
  *  PRIu64
  *
  * <stdio.h>
  *  FILE
  *  SEEK_END
  *  SEEK_SET
+ *  fclose()
+ *  fileno()
  *  fopen()
  *  fprintf()
- *  fseek()
- *  ftell()
+ *  fseeko()
+ *  ftello()
+ *  off_t
  *  printf()
+ *  remove()
+ *  rename()
  *  stderr
+ *  stdin
  *
  * <stdlib.h>
  *  EXIT_FAILURE
  *  EXIT_SUCCESS
- *  qsort()
+ *  free()
+ *  malloc()
  *  size_t
+ *  strtoul()
+ *  strtoull()
+ *
+ * <stdint.h>
+ *  SIZE_MAX
  *
  * <string.h>
+ *  memcpy()
  *  strcmp()
+ *  strlen()
+ *
+ * <sys/mman.h>
+ *  MAP_FAILED
+ *  MAP_PRIVATE
+ *  PROT_READ
+ *  mmap()
+ *  munmap()
+ *
+ * <sys/stat.h>
+ *  S_ISDIR()
+ *  stat()
+ *
+ * <time.h>
+ *  CLOCK_MONOTONIC
+ *  clock_gettime()
+ *  struct timespec
+ *
+ * <unistd.h>
+ *  _SC_NPROCESSORS_ONLN
+ *  sysconf()
  */
 #include <errno.h>
+#include <getopt.h>
 #include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 /*
  * <utils/ifjmp.h>
@@ -38,94 +86,497 @@
  */
 #include <utils/ifjmp.h>
 
+#include "fs.h"
 #include "star.h"
 
 #define eprintf(MSG, ...)   (fprintf(stderr, MSG "\n", __VA_ARGS__))
 #define errprintf(MSG, ...) (fprintf(stderr, MSG ": %s\n", __VA_ARGS__, strerror(errno)))
 
-u32 fsize (FILE * stream)
+/* command line options */
+static struct {
+    /* order in which `create()` reads its inputs */
+    enum fs_order order;
+    /* archive the files under directories given to `create()` */
+    bool recurse;
+    /* number of threads to use */
+    unsigned jobs;
+    /* file with a `NULL` separated list of files for `create()`, `-` for `stdin` */
+    const char * list;
+    /* keep the given order of files */
+    bool nosort;
+    /* store the data of identical files only once */
+    bool dedup;
+    /* store identical chunks of files only once */
+    bool chunk;
+    /* codec to compress files with, see `enum StarCodec` */
+    u8 codec;
+    /* store small files together in solid blocks */
+    bool solid;
+    /* compress files against a dictionary trained on them */
+    bool train;
+    /* store the checksum of each chunk of files */
+    bool chunk_crc;
+    /* lay out the headers to be used in place */
+    bool mappable;
+    /* boundary to align the data of files to, `0` for none */
+    u64 align;
+    /* smallest file whose data is aligned */
+    u64 align_min;
+    /* read and write archives bypassing the page cache */
+    bool direct;
+    /* store only the runs of data of files with holes */
+    bool sparse;
+    /* put the headers after the data, so that files can be appended */
+    bool appendable;
+} opts = {
+    .order = FS_ORDER_ARGS,
+    .jobs = 1,
+};
+
+u64 fsize (FILE * stream)
 {
-    u32 ret = 0;
+    u64 ret = 0;
 
     ifjmp(stream == NULL, out);
 
-    long old = ftell(stream);
+    /* `off_t`, unlike `long`, is 64 bits wide even on 32-bit systems */
+    off_t old = ftello(stream);
     ifjmp(old < 0, out);
-    ifjmp(fseek(stream, 0, SEEK_END) != 0, out);
-    long size = ftell(stream);
+    ifjmp(fseeko(stream, 0, SEEK_END) != 0, out);
+    off_t size = ftello(stream);
     ifjmp(size < 0, out);
-    fseek(stream, old, SEEK_SET);
+    fseeko(stream, old, SEEK_SET);
 
     ret = (size >= 0) ?
-        size :
+        (u64) size :
         0 ;
 
 out:
     return ret;
 }
 
+/* open the archive at PATH into S, bypassing the page cache with `-O` */
+static bool open_archive (Stream * s, const char * path, bool write)
+{
+    return (opts.direct) ?
+        stream_from_direct(s, path, write) :
+        stream_from_file(s, fopen(path, (write) ? "wb" : "rb"));
+}
+
+/* seconds since some fixed point, to time the stages of `create()` */
+static double now (void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* report how fast a stage of `create()`, started at START, went through BYTES */
+static void stage (const char * name, u64 bytes, double start)
+{
+    double secs = now() - start;
+    eprintf("%s: %" PRIu64 " B in %.3f s (%.1f MiB/s)", name, bytes, secs,
+            (secs > 0) ? (double) bytes / secs / (1 << 20) : 0.0);
+}
+
 void usage (char * cmd)
 {
     eprintf(
-            "%s c ARCHIVE FILE...\n"
+            "%s c [OPTION]... ARCHIVE [FILE]...\n"
             "\tCreate a STAR named ARCHIVE with FILE.\n"
+            "%s a [OPTION]... ARCHIVE [FILE]...\n"
+            "\tAppend FILE to ARCHIVE, which was created with -E, writing only FILE and the headers. Create ARCHIVE if it doesn't exist.\n"
             "%s x ARCHIVE [FILE]...\n"
             "\tIf no FILE is given, extract every file of ARCHIVE. Else extract only FILE from ARCHIVE.\n"
+            "%s d ARCHIVE [FILE]...\n"
+            "\tDelete FILE from ARCHIVE, which was created with -E, writing only the headers; its data is there until ARCHIVE is compacted.\n"
+            "%s p [OPTION]... ARCHIVE...\n"
+            "\tCompact ARCHIVE, copying only the files that weren't deleted.\n"
             "%s l ARCHIVE...\n"
-            "\tList files in ARCHIVE.",
-            cmd, cmd, cmd);
+            "\tList files in ARCHIVE.\n"
+            "%s t [OPTION]... ARCHIVE...\n"
+            "\tCheck that ARCHIVE is sound, and the data of every file in it matches its checksum.\n"
+            "\n"
+            "Options:\n"
+            "\t-i\tRead FILEs in inode order (the archive keeps the given order).\n"
+            "\t-e\tRead FILEs in on-disk order of their first extent, if known, else as -i.\n"
+            "\t-r\tArchive the files under FILE, if FILE is a directory.\n"
+            "\t-j N\tUse N threads where possible (0 for one per CPU; default 1).\n"
+            "\t-T LIST\tAlso archive the NUL separated files in LIST (- for standard input).\n"
+            "\t-n\tDon't sort FILEs, keep the order they were given in.\n"
+            "\t-d\tStore the data of identical FILEs only once.\n"
+            "\t-D\tSplit FILEs in content defined chunks and store identical chunks only once.\n"
+            "\t-z\tCompress each FILE (or each of its chunks, with -D) on its own.\n"
+            "\t-s\tCompress small FILEs together, in solid blocks (implies -z).\n"
+            "\t-Z\tCompress each FILE against a dictionary made of samples of all FILEs (implies -z).\n"
+            "\t-C\tAlso store the checksum of each chunk (or block) of big FILEs, to check them a piece at a time.\n"
+            "\t-M\tLay out the headers to be used in place, so that x finds FILEs without reading all of them.\n"
+            "\t-a N\tStart the data of each FILE (and solid block) on a multiple of N bytes (e.g. 4096), padding before it (1 for none). a and p keep how ARCHIVE was aligned, unless given.\n"
+            "\t-A N\tWith -a (or ARCHIVE's alignment, for a and p), align only FILEs (and solid blocks) of at least N bytes.\n"
+            "\t-O\tRead and write ARCHIVE bypassing the page cache (O_DIRECT), in big aligned pieces.\n"
+            "\t-S\tStore only the data of FILEs with holes, and leave the holes as holes on x (implies -M).\n"
+            "\t-E\tPut the headers after the data, so that FILEs can be appended with a (implies -M).",
+            cmd, cmd, cmd, cmd, cmd, cmd, cmd);
+}
+
+/*
+ * find the files to archive in ARCHIVE, ARGS[0]: the other N - 1 ARGS,
+ * the files under them with `-r`, and the files in the `-T` list; sorted,
+ * unless `-n`
+ */
+static bool find_inputs (int n, char ** args, struct fs_paths * inputs)
+{
+    for (int i = 1; i < n; i++) {
+        struct stat st = {0};
+
+        if (opts.recurse && stat(args[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            if (!fs_walk(inputs, args[i], opts.jobs)) {
+                eprintf("Error reading directory `%s`", args[i]);
+                return false;
+            }
+        } else if (!fs_paths_push(inputs, args[i], strlen(args[i]))) {
+            errprintf("Error adding file `%s`", args[i]);
+            return false;
+        }
+    }
+
+    if (opts.list != NULL) {
+        bool is_stdin = strcmp(opts.list, "-") == 0;
+        Stream list = {0};
+
+        if (!stream_from_file(&list, is_stdin ? stdin : fopen(opts.list, "rb"))) {
+            errprintf("Error opening `%s`", opts.list);
+            return false;
+        }
+
+        bool ok = fs_paths_read(inputs, &list);
+
+        if (!is_stdin)
+            stream_close(&list);
+
+        if (!ok) {
+            errprintf("Error reading the list of files `%s`", opts.list);
+            return false;
+        }
+    }
+
+    if (inputs->n == 0 || inputs->n > UINT32_MAX) {
+        eprintf("Can't archive %zu files in `%s`", inputs->n, args[0]);
+        return false;
+    }
+
+    if (!opts.nosort)
+        star_sort(inputs->v, inputs->n);
+
+    return true;
+}
+
+/*
+ * add INPUTS to STAR, each as the file FIRST plus its index in INPUTS;
+ * how many bytes were read goes in TOTAL
+ */
+static bool read_inputs (struct STAR * star, u32 first, const struct fs_paths * inputs, u64 * total)
+{
+    /* read in whatever order is faster, but keep the given order in the STAR */
+    size_t * order = fs_order(inputs->v, inputs->n, opts.order);
+    if (order == NULL)
+        return false;
+
+    bool ret = true;
+    double start = now();
+    *total = 0;
+
+    for (size_t k = 0; k < inputs->n && ret; k++) {
+        u32 i = (u32) order[k];
+        char * path = inputs->v[i];
+        Stream in = {0};
+
+        if (!stream_from_file(&in, fopen(path, "rb"))) {
+            errprintf("Error opening `%s`", path);
+            ret = false;
+            break;
+        }
+
+        u64 size = fsize(stream_file(&in));
+        eprintf("Archiving `%s`", path);
+
+        ret = (opts.sparse) ?
+            star_add_sparse(star, first + i, (void *) path, size, &in) :
+            star_add_file(star, first + i, (void *) path, size, &in) ;
+
+        if (!ret)
+            errprintf("Error adding file `%s`", path);
+
+        stream_close(&in);
+        *total += size;
+    }
+
+    free(order);
+
+    if (ret)
+        stage("read", *total, start);
+    return ret;
 }
 
 /* TODO: better file names handling */
-int create (int _n, char ** args)
+int create (int n, char ** args)
 {
     int ret = EXIT_FAILURE;
     Stream out = {0};
-    Stream in = {0};
+    struct STAR * star = NULL;
+    struct fs_paths inputs = {0};
+    u64 total = 0;
+
+    ifjmp(!find_inputs(n, args, &inputs), out);
 
-    u32 n = (u32) _n; /* `_n > 0` */
-    struct STAR * star = star_new(n - 1);
+    star = star_new((u32) inputs.n);
     ifjmp(star == NULL, out);
 
-    for (u32 i = 1; i < n; i++) {
-        if (!stream_from_file(&in, fopen(args[i], "rb"))) {
-            errprintf("Error opening `%s`", args[i]);
+    ifjmp(!read_inputs(star, 0, &inputs, &total), out);
+
+    double start = now();
+
+    if (opts.dedup) {
+        start = now();
+
+        if (!star_dedup(star, opts.jobs)) {
+            eprintf("Error looking for identical files for `%s`", args[0]);
             goto out;
         }
 
-        u32 size = fsize(stream_file(&in));
-        eprintf("Archiving `%s`", args[i]);
+        stage("dedup", total, start);
 
-        if (!star_add_file(star, i - 1, (void *) args[i], size, &in)) {
-            errprintf("Error adding file `%s`", args[i]);
+        u64 nsame = 0;
+        u64 saved = 0;
+        for (u32 i = 0; i < star->header.nfiles; i++) {
+            if (star->same[i] != i) {
+                nsame++;
+                saved += star->fheaders[i].size;
+            }
+        }
+
+        eprintf("%" PRIu64 " files share data with others, saving %" PRIu64 " B",
+                nsame, saved);
+    }
+
+    if (opts.chunk) {
+        start = now();
+
+        if (!star_chunk(star, opts.jobs)) {
+            eprintf("Error splitting files in chunks for `%s`", args[0]);
             goto out;
         }
 
-        stream_close(&in);
+        stage("chunk", total, start);
+
+        u64 nchunks = 0;
+        u64 nsame = 0;
+        u64 saved = 0;
+        for (u32 i = 0; i < star->header.nfiles; i++) {
+            const struct StarFileHeader * fh = star->fheaders + i;
+            nchunks += fh->nchunks;
+            for (u32 c = 0; c < fh->nchunks; c++) {
+                if (fh->chunks[c].same != NULL) {
+                    nsame++;
+                    saved += fh->chunks[c].size;
+                }
+            }
+        }
+
+        eprintf("%" PRIu64 " of %" PRIu64 " chunks share data with others, saving %" PRIu64 " B",
+                nsame, nchunks, saved);
+    }
+
+    if (opts.train) {
+        start = now();
+
+        if (!star_train(star)) {
+            eprintf("Error making a dictionary for `%s`", args[0]);
+            goto out;
+        }
+
+        stage("train", total, start);
+        eprintf("Dictionary of %" PRIu32 " B", star->header.dsize);
+    }
+
+    if (opts.solid) {
+        if (!star_solid(star)) {
+            eprintf("Error putting small files in solid blocks for `%s`", args[0]);
+            goto out;
+        }
+
+        u64 nsolid = 0;
+        for (u32 i = 0; i < star->header.nfiles; i++)
+            nsolid += (star->fheaders[i].flags & STAR_F_SOLID) != 0;
+
+        eprintf("%" PRIu64 " files in %" PRIu32 " solid blocks",
+                nsolid, star->header.nblocks);
     }
 
+    if (opts.chunk_crc) {
+        start = now();
+
+        if (!star_chunk_crc(star, opts.jobs)) {
+            eprintf("Error calculating the checksums of chunks for `%s`", args[0]);
+            goto out;
+        }
+
+        stage("checksum", total, start);
+    }
+
+    if (opts.codec != STAR_CODEC_NONE) {
+        start = now();
+
+        if (!star_compress(star, opts.codec, opts.jobs)) {
+            eprintf("Error compressing files for `%s`", args[0]);
+            goto out;
+        }
+
+        u64 size = 0;
+        u64 csize = 0;
+        for (u32 b = 0; b < star->header.nblocks; b++) {
+            size += star->blocks[b].size;
+            csize += star->blocks[b].csize;
+        }
+
+        for (u32 i = 0; i < star->header.nfiles; i++) {
+            const struct StarFileHeader * fh = star->fheaders + i;
+
+            if (fh->flags & STAR_F_SOLID) {
+                continue;
+            } else if (fh->flags & STAR_F_CHUNKED) {
+                for (u32 c = 0; c < fh->nchunks; c++) {
+                    if (fh->chunks[c].same == NULL) {
+                        size += fh->chunks[c].size;
+                        csize += fh->chunks[c].csize;
+                    }
+                }
+            } else if (star->same == NULL || star->same[i] == i) {
+                size += fh->size;
+                csize += fh->csize;
+            }
+        }
+
+        stage("compress", size, start);
+        eprintf("Compressed %" PRIu64 " B to %" PRIu64 " B", size, csize);
+
+        u64 nraw = 0;
+        for (u32 i = 0; i < star->header.nfiles; i++)
+            nraw += (star->fheaders[i].flags & STAR_F_INCOMPRESSIBLE) != 0;
+
+        if (nraw > 0)
+            eprintf("%" PRIu64 " files are incompressible, stored as is", nraw);
+    }
+
+    star->mappable = opts.mappable;
+    star->appendable = opts.appendable;
+    star->align = opts.align;
+    star->align_min = opts.align_min;
     star_file_offsets(star);
 
-    if (!stream_from_file(&out, fopen(args[0], "wb"))) {
+    start = now();
+
+    if (!open_archive(&out, args[0], true)) {
         errprintf("Error opening `%s`", args[0]);
         goto out;
     }
 
-    if (!star_write(star, &out)) {
+    /* laid out at once; where it can't be, it's written as usual */
+    stream_reserve(&out, star->size);
+
+    if (!star_write(star, &out) || !stream_flush(&out)) {
         eprintf("Error writing STAR file `%s`", *args);
         goto out;
     }
 
+    u64 written = 0;
+    stream_tell(&out, &written);
+    stage("write", written, start);
+
+    if (opts.align > 1)
+        eprintf("Aligned data to %" PRIu64 " B with %" PRIu64 " B of padding (%.2f%% of the STAR)",
+                opts.align, star->padding,
+                (written > 0) ? 100.0 * (double) star->padding / (double) written : 0.0);
+
     ret = EXIT_SUCCESS;
 
 out:
+    fs_paths_free(&inputs);
     stream_close(&out);
-    stream_close(&in);
     star_free(star);
     return ret;
 }
 
-#define _extract_file_id(S, ID) do {                      \
+int append (int n, char ** args)
+{
+    int ret = EXIT_FAILURE;
+    Stream io = {0};
+    struct STAR * star = NULL;
+    struct fs_paths inputs = {0};
+    u64 total = 0;
+
+    if (!stream_from_file(&io, fopen(args[0], "r+b"))) {
+        if (errno != ENOENT) {
+            errprintf("Error opening `%s`", args[0]);
+            return ret;
+        }
+
+        /* nothing to append to, so start one that can be */
+        opts.appendable = true;
+        return create(n, args);
+    }
+
+    star = star_read_headers(&io);
+    if (star == NULL) {
+        eprintf("An error occurred reading `%s`", args[0]);
+        goto out;
+    }
+
+    if (!star->appendable) {
+        eprintf("Can't append to `%s`, it wasn't created with -E", args[0]);
+        goto out;
+    }
+
+    /* the files are appended as they are, each with its own data */
+    if (opts.dedup || opts.chunk || opts.codec != STAR_CODEC_NONE || opts.chunk_crc) {
+        eprintf("Can't append to `%s` with -d, -D, -z, -s, -Z, or -C", args[0]);
+        goto out;
+    }
+
+    ifjmp(!find_inputs(n, args, &inputs), out);
+
+    u32 first = star->header.nfiles;
+    if (!star_extend(star, (u32) inputs.n)) {
+        eprintf("Can't append %zu files to `%s`", inputs.n, args[0]);
+        goto out;
+    }
+
+    ifjmp(!read_inputs(star, first, &inputs, &total), out);
+
+    /* as the rest of the data, unless asked otherwise */
+    if (opts.align != 0)
+        star->align = opts.align;
+    if (opts.align_min != 0)
+        star->align_min = opts.align_min;
+
+    double start = now();
+
+    if (!star_append(star, first, &io)) {
+        eprintf("Error appending to STAR file `%s`", args[0]);
+        goto out;
+    }
+
+    stage("write", total, start);
+    ret = EXIT_SUCCESS;
+
+out:
+    fs_paths_free(&inputs);
+    stream_close(&io);
+    star_free(star);
+    return ret;
+}
+
+#define _extract_file_id(S, IN, ID) do {                  \
     Stream out = {0};                                     \
     if (!stream_from_file(&out,                           \
                 fopen((void *) (S)->fheaders[(ID)].path,  \
@@ -136,49 +587,241 @@ out:
         break;                                            \
     }                                                     \
     eprintf("Extracting `%s`", (S)->fheaders[(ID)].path); \
-    size_t w = stream_write(&out, (S)->fdata[(ID)],       \
-            (S)->fheaders[(ID)].size, 1);                 \
-    if (w != 1)                                           \
-    eprintf("An error occurred writing `%s`",             \
+    if (!star_extract((S), (ID), (IN), &out))             \
+    eprintf("`%s` is corrupt, or couldn't be written",    \
             (S)->fheaders[(ID)].path);                    \
     stream_close(&out);                                   \
 } while (0)
 
+/*
+ * extract only the files given from a STAR of version 9, mapped and used
+ * in place, without reading every header; `false` if it isn't one
+ */
+static bool extract_mapped (int n, char ** args)
+{
+    bool ret = false;
+    struct StarMap map = {0};
+
+    FILE * file = fopen(args[0], "rb");
+    ifjmp(file == NULL, out);
+
+    u64 size = fsize(file);
+    void * data = (size > 0 && size <= SIZE_MAX) ?
+        mmap(NULL, (size_t) size, PROT_READ, MAP_PRIVATE, fileno(file), 0) :
+        MAP_FAILED ;
+    fclose(file);
+    ifjmp(data == MAP_FAILED, out);
+
+    ret = star_map(&map, data, size);
+
+    for (int i = 1; i < n && ret; i++) {
+        u64 id = star_map_search(&map, (void *) args[i]);
+        if (id == STAR_DNF) {
+            eprintf("No file named `%s` was found", args[i]);
+            continue;
+        }
+
+        const char * path = (const void *) star_map_path(&map, id);
+        Stream fout = {0};
+        if (!stream_from_file(&fout, fopen(path, "w+b"))) {
+            errprintf("Could not open `%s`", path);
+            continue;
+        }
+
+        eprintf("Extracting `%s`", path);
+        if (!star_map_extract(&map, id, &fout))
+            eprintf("`%s` is corrupt, or couldn't be written", path);
+        stream_close(&fout);
+    }
+
+    munmap(data, (size_t) size);
+
+out:
+    return ret;
+}
+
 /* TODO: (maybe?) create file hierarchy (directories) */
 int extract (int n, char ** args)
 {
+    /* mapped, it'd go through the page cache */
+    if (n > 1 && !opts.direct && extract_mapped(n, args))
+        return EXIT_SUCCESS;
+
     Stream in = {0};
-    if (!stream_from_file(&in, fopen(args[0], "rb"))) {
+    if (!open_archive(&in, args[0], false)) {
         eprintf("Error occurred opening `%s`", args[0]);
         return EXIT_FAILURE;
     }
 
-    struct STAR * star = star_read(&in);
-    stream_close(&in);
+    /* only the headers; the data is read as each file is extracted */
+    stream_hint(&in, STREAM_HINT_SEQUENTIAL);
+    struct STAR * star = star_read_headers(&in);
     if (star == NULL) {
         eprintf("Error occurred reading `%s`", args[0]);
+        stream_close(&in);
         return EXIT_FAILURE;
     }
 
     if (n == 1) { /* extract every file */
-        for (u64 fi = 0; fi < star->header.nfiles; fi++)
-            _extract_file_id(star, fi);
+        /* deleted files are there until compacted, but aren't extracted */
+        for (u64 fi = 0; fi < star->header.nfiles; fi++) {
+            if (!(star->fheaders[fi].flags & STAR_F_DELETED))
+                _extract_file_id(star, &in, fi);
+        }
     } else { /* extract only specified files */
+        /* out of order, each read ahead while the one before is extracted */
+        stream_hint(&in, STREAM_HINT_RANDOM);
+        u64 next = star_search(star, (void *) args[1]);
+        star_prefetch(star, next, &in);
+
         for (int i = 1; i < n; i++) {
-            u64 id = star_search(star, (void *) args[i]);
+            u64 id = next;
+            next = (i + 1 < n) ? star_search(star, (void *) args[i + 1]) : UINT64_MAX;
+            star_prefetch(star, next, &in);
+
             if (id != UINT64_MAX)
-                _extract_file_id(star, id);
+                _extract_file_id(star, &in, id);
             else
                 eprintf("No file named `%s` was found", args[i]);
         }
     }
 
+    stream_close(&in);
     star_free(star);
 
     return EXIT_SUCCESS;
 }
 
-/* TODO: read headers only, not fdata */
+int delete (int n, char ** args)
+{
+    int ret = EXIT_FAILURE;
+    Stream io = {0};
+    struct STAR * star = NULL;
+
+    if (!stream_from_file(&io, fopen(args[0], "r+b"))) {
+        errprintf("Error opening `%s`", args[0]);
+        goto out;
+    }
+
+    star = star_read_headers(&io);
+    if (star == NULL) {
+        eprintf("An error occurred reading `%s`", args[0]);
+        goto out;
+    }
+
+    if (!star->appendable) {
+        eprintf("Can't delete from `%s`, it wasn't created with -E", args[0]);
+        goto out;
+    }
+
+    /* every file named, as many times as it was archived */
+    u64 ndeleted = 0;
+    for (int i = 1; i < n; i++) {
+        u64 id = star_search(star, (void *) args[i]);
+        if (id == STAR_DNF)
+            eprintf("No file named `%s` was found", args[i]);
+
+        for (; id != STAR_DNF; id = star_search(star, (void *) args[i])) {
+            star_delete(star, id);
+            ndeleted++;
+        }
+    }
+
+    /* only the headers are written */
+    if (ndeleted > 0 && !star_append(star, star->header.nfiles, &io)) {
+        eprintf("Error writing the headers of `%s`", args[0]);
+        goto out;
+    }
+
+    eprintf("Deleted %" PRIu64 " files from `%s`", ndeleted, args[0]);
+    ret = EXIT_SUCCESS;
+
+out:
+    stream_close(&io);
+    star_free(star);
+    return ret;
+}
+
+int compact (int n, char ** args)
+{
+    int ret = EXIT_SUCCESS;
+
+    for (int i = 0; i < n; i++) {
+        Stream in = {0};
+        Stream out = {0};
+        struct STAR * star = NULL;
+        u64 size = 0;
+
+        /* written aside, and put in its place only once it's whole */
+        size_t len = strlen(args[i]);
+        char * tmp = malloc(len + sizeof(".tmp"));
+        if (tmp == NULL) {
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        memcpy(tmp, args[i], len);
+        memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+        if (!open_archive(&in, args[i], false)) {
+            errprintf("Could not open `%s`", args[i]);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        stream_hint(&in, STREAM_HINT_SEQUENTIAL);
+        star = star_read_headers(&in);
+        if (star == NULL || !stream_size(&in, &size)) {
+            eprintf("`%s`: not a STAR, or its headers are corrupt", args[i]);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        u64 nleft = 0;
+        for (u64 idx = 0; idx < star->header.nfiles; idx++)
+            nleft += !(star->fheaders[idx].flags & STAR_F_DELETED);
+
+        if (nleft == 0) {
+            eprintf("Every file of `%s` was deleted, there's nothing to keep", args[i]);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        if (!open_archive(&out, tmp, true)) {
+            errprintf("Error opening `%s`", tmp);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        double start = now();
+        /* as it was, unless asked otherwise */
+        if (opts.align != 0)
+            star->align = opts.align;
+        if (opts.align_min != 0)
+            star->align_min = opts.align_min;
+
+        bool ok = star_compact(star, &in, &out) && stream_flush(&out);
+        stream_close(&out);
+
+        if (!ok || rename(tmp, args[i]) != 0) {
+            eprintf("Error compacting `%s`", args[i]);
+            remove(tmp);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        stage("compact", star->size, start);
+        eprintf("Compacted `%s` from %" PRIu64 " B to %" PRIu64 " B",
+                args[i], size, star->size);
+
+next:
+        free(tmp);
+        star_free(star);
+        stream_close(&in);
+    }
+
+    return ret;
+}
+
 int list (int n, char ** args)
 {
     int ret = EXIT_SUCCESS;
@@ -186,14 +829,15 @@ int list (int n, char ** args)
     for (int i = 0; i < n; i++) {
         Stream in = {0};
 
-        if (!stream_from_file(&in, fopen(args[i], "rb"))) {
+        if (!open_archive(&in, args[i], false)) {
             errprintf("Could not open `%s`", args[i]);
             ret = EXIT_FAILURE;
             stream_close(&in);
             continue;
         }
 
-        struct STAR * star = star_read(&in);
+        stream_hint(&in, STREAM_HINT_SEQUENTIAL);
+        struct STAR * star = star_read_headers(&in);
         stream_close(&in);
 
         if (star == NULL) {
@@ -203,10 +847,51 @@ int list (int n, char ** args)
         }
 
         printf("%s:\n", args[i]);
-        for (u64 idx = 0; idx < star->header.nfiles; idx++)
-            printf("\t`%s` (%" PRIu32 " B)\n",
-                    star->fheaders[idx].path,
-                    star->fheaders[idx].size);
+        if (star->header.dsize > 0)
+            printf("\t(dictionary of %" PRIu32 " B)\n", star->header.dsize);
+
+        u64 ndeleted = 0;
+        for (u64 idx = 0; idx < star->header.nfiles; idx++) {
+            const struct StarFileHeader * fh = star->fheaders + idx;
+
+            if (fh->flags & STAR_F_DELETED) {
+                ndeleted++;
+                continue;
+            }
+
+            /* the size of a sparse file is of its runs of data, as stored */
+            const char * sparse = (fh->flags & STAR_F_SPARSE) ? ", sparse" : "";
+
+            if (fh->flags & STAR_F_SOLID) {
+                printf("\t`%s` (%" PRIu64 " B%s, in solid block %" PRIu32 ")\n",
+                        fh->path, fh->size, sparse, fh->block);
+                continue;
+            }
+
+            if (fh->flags & STAR_F_INCOMPRESSIBLE) {
+                printf("\t`%s` (%" PRIu64 " B%s, incompressible, stored as is)\n",
+                        fh->path, fh->size, sparse);
+                continue;
+            }
+
+            if (fh->codec == STAR_CODEC_NONE) {
+                printf("\t`%s` (%" PRIu64 " B%s)\n", fh->path, fh->size, sparse);
+                continue;
+            }
+
+            u64 csize = fh->csize;
+            if (fh->flags & STAR_F_CHUNKED) {
+                csize = 0;
+                for (u32 c = 0; c < fh->nchunks; c++)
+                    csize += fh->chunks[c].csize;
+            }
+
+            printf("\t`%s` (%" PRIu64 " B%s, %" PRIu64 " B stored)\n",
+                    fh->path, fh->size, sparse, csize);
+        }
+
+        if (ndeleted > 0)
+            printf("\t(%" PRIu64 " deleted files, stored until compacted)\n", ndeleted);
 
         star_free(star);
     }
@@ -214,30 +899,130 @@ int list (int n, char ** args)
     return ret;
 }
 
-int argv_strcmp (const void * _l, const void * _r)
+int test (int n, char ** args)
 {
-    const char * l = * (const char **) _l;
-    const char * r = * (const char **) _r;
-    return star_strcmp(l, r);
+    int ret = EXIT_SUCCESS;
+
+    for (int i = 0; i < n; i++) {
+        Stream in = {0};
+        struct STAR * star = NULL;
+        bool * bad = NULL;
+        u64 size = 0;
+
+        if (!open_archive(&in, args[i], false)) {
+            errprintf("Could not open `%s`", args[i]);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+
+        star = star_read_headers(&in);
+        if (star == NULL || !stream_size(&in, &size)) {
+            eprintf("`%s`: not a STAR, or its headers are corrupt", args[i]);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        bad = malloc(star->header.nfiles * sizeof(bool) + 1);
+        u64 nbad = (bad != NULL) ?
+            star_verify(star, &in, size, opts.jobs, bad) :
+            STAR_DNF ;
+
+        if (nbad == STAR_DNF) {
+            eprintf("`%s`: an error occurred checking it", args[i]);
+            ret = EXIT_FAILURE;
+            goto next;
+        }
+
+        for (u64 idx = 0; idx < star->header.nfiles; idx++)
+            if (bad[idx])
+                printf("%s: `%s` is corrupt\n", args[i], star->fheaders[idx].path);
+
+        if (nbad > 0) {
+            printf("%s: %" PRIu64 " of %" PRIu32 " files are corrupt\n",
+                    args[i], nbad, star->header.nfiles);
+            ret = EXIT_FAILURE;
+        } else {
+            printf("%s: all %" PRIu32 " files are sound\n",
+                    args[i], star->header.nfiles);
+        }
+
+next:
+        free(bad);
+        star_free(star);
+        stream_close(&in);
+    }
+
+    return ret;
 }
 
 int main (int argc, char ** argv)
 {
     ifjmp(argc < 2, usage);
 
-#define cmd(f, s, n) ((strcmp(argv[1], (s)) == 0) && argc >= (n)) ? (f)
+    /*
+     * options come after the command, which acts as `argv[0]`;
+     * `getopt_long()` lets them come after ARCHIVE too, even with musl
+     */
+    static const struct option longopts[] = { {0} };
+    for (int opt = 0; (opt = getopt_long(argc - 1, argv + 1, "a:A:CdDeEj:iMnOrsST:zZ", longopts, NULL)) != -1; ) {
+        switch (opt) {
+            case 'C': opts.chunk_crc = true;        break;
+            case 'd': opts.dedup = true;            break;
+            case 'D': opts.chunk = true;            break;
+            case 'i': opts.order = FS_ORDER_INODE;  break;
+            case 'M': opts.mappable = true;         break;
+            case 'e': opts.order = FS_ORDER_EXTENT; break;
+            case 'E': opts.appendable = true;       break;
+            case 'n': opts.nosort = true;           break;
+            case 'O': opts.direct = true;           break;
+            case 'r': opts.recurse = true;          break;
+            case 's': opts.solid = true;            break;
+            case 'S': opts.sparse = true;           break;
+            case 'T': opts.list = optarg;           break;
+            case 'z': opts.codec = STAR_CODEC_LZ;   break;
+            case 'Z': opts.train = true;            break;
+            case 'j': opts.jobs = (unsigned) strtoul(optarg, NULL, 10); break;
+            case 'a': opts.align = strtoull(optarg, NULL, 10); break;
+            case 'A': opts.align_min = strtoull(optarg, NULL, 10); break;
+            default: goto usage;
+        }
+    }
+
+    /* solid blocks are there to be compressed */
+    if (opts.solid && opts.codec == STAR_CODEC_NONE)
+        opts.codec = STAR_CODEC_LZ;
+
+    /* and so is the dictionary */
+    if (opts.train)
+        opts.codec = STAR_CODEC_LZ_DICT;
+
+    if (opts.jobs == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        opts.jobs = (ncpus > 0) ? (unsigned) ncpus : 1;
+    }
+
+    int nargs = argc - 1 - optind;
+    char ** args = argv + 1 + optind;
+
+#define cmd(f, s, n) ((strcmp(argv[1], (s)) == 0) && nargs >= (n)) ? (f)
     int (*todo) (int, char **) =
-        cmd(create,  "c", 4) : /* star c archive file+ */
-        cmd(extract, "x", 3) : /* star x archive file* */
-        cmd(list,    "l", 3) : /* star l archive+      */
+        cmd(create,  "c", 1) : /* star c archive file* */
+        cmd(append,  "a", 1) : /* star a archive file* */
+        cmd(extract, "x", 1) : /* star x archive file* */
+        cmd(delete,  "d", 1) : /* star d archive file* */
+        cmd(compact, "p", 1) : /* star p archive+      */
+        cmd(list,    "l", 1) : /* star l archive+      */
+        cmd(test,    "t", 1) : /* star t archive+      */
         NULL ;
 #undef cmd
 
     ifjmp(todo == NULL, usage);
 
-    qsort(argv + 3, argc - 3, sizeof(char *), argv_strcmp);
+    /* `create()` and `append()` sort their inputs themselves, after finding them all */
+    if (todo != create && todo != append && !opts.nosort)
+        star_sort(args + 1, (size_t) nargs - 1);
 
-    return todo(argc - 2, argv + 2);
+    return todo(nargs, args);
 
 usage:
     usage(*argv);
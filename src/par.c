@@ -0,0 +1,77 @@
+/*
+ * <pthread.h>
+ *  pthread_create()
+ *  pthread_join()
+ *  pthread_t
+ *
+ * <stdatomic.h>
+ *  atomic_fetch_add()
+ *  atomic_size_t
+ *
+ * <stdlib.h>
+ *  calloc()
+ *  free()
+ *  size_t
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "par.h"
+
+/**
+ * @brief State shared by the threads of a `par_for()`
+ */
+struct _par_for {
+    /** The next index to hand out */
+    atomic_size_t next;
+    /** Number of calls */
+    size_t n;
+    /** The function to call */
+    void (*fn) (void * ctx, size_t i);
+    /** Its context */
+    void * ctx;
+};
+
+static void * _par_for_worker (void * arg)
+{
+    struct _par_for * self = arg;
+
+    for (size_t i = 0; (i = atomic_fetch_add(&self->next, 1)) < self->n; )
+        self->fn(self->ctx, i);
+
+    return NULL;
+}
+
+void par_for (size_t n, unsigned nthreads, void (*fn) (void * ctx, size_t i), void * ctx)
+{
+    if (fn == NULL || n == 0)
+        return;
+
+    struct _par_for self = {
+        .n = n,
+        .fn = fn,
+        .ctx = ctx,
+    };
+    atomic_init(&self.next, 0);
+
+    /* no point in having more threads than calls */
+    if (nthreads > n)
+        nthreads = (unsigned) n;
+
+    pthread_t * threads = (nthreads > 1) ?
+        calloc(nthreads - 1, sizeof(pthread_t)) :
+        NULL ;
+
+    unsigned nstarted = 0;
+    while (threads != NULL && nstarted < nthreads - 1
+            && pthread_create(threads + nstarted, NULL, _par_for_worker, &self) == 0)
+        nstarted++;
+
+    _par_for_worker(&self);
+
+    for (unsigned i = 0; i < nstarted; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+}
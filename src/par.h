@@ -0,0 +1,25 @@
+#ifndef _PAR_H
+#define _PAR_H
+
+/*
+ * <stdlib.h>
+ *  size_t
+ */
+#include <stdlib.h>
+
+/**
+ * @brief Call `fn(ctx, i)` for every `i` in `[0, n)`, spread over
+ *     @a nthreads threads (the calling thread included)
+ * @param n Number of calls
+ * @param nthreads Maximum number of threads to use
+ * @param fn The function to call
+ * @param ctx Passed as is to @a fn
+ *
+ * Indices are handed out one at a time, in increasing order, to
+ * whichever thread is free, so calls may take very different times.
+ * If threads can't be created, fewer are used; with a single thread,
+ * the calls are made in order.
+ */
+void par_for (size_t n, unsigned nthreads, void (*fn) (void * ctx, size_t i), void * ctx);
+
+#endif /* _PAR_H */
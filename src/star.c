@@ -3,35 +3,126 @@
  *  CHAR_BIT
  *  UCHAR_MAX
  *
+ * <stddef.h>
+ *  offsetof()
+ *
+ * <stdint.h>
+ *  INT64_MAX
+ *  SIZE_MAX
+ *  UINT64_C()
+ *  uintptr_t
+ *
  * <stdlib.h>
  *  bsearch()
  *  calloc()
  *  free()
  *  malloc()
+ *  qsort()
+ *  realloc()
  *
  * <string.h>
  *  memcmp()
- *  strcmp()
+ *  memcpy()
+ *  memset()
  *  strdup()
  *  strlen()
  *  strncmp()
  */
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 /*
+ * <utils/common.h>
+ *  min()
+ *
  * <utils/ifjmp.h>
  *  ifjmp()
  */
+#include <utils/common.h>
 #include <utils/ifjmp.h>
 
+#include "hash.h"
+#include "lz.h"
+#include "par.h"
 #include "stream.h"
 #include "star.h"
 
 static const u8 STAR_MAGIC[4] = { 0x53, 0x54, 0x41, 0x52 };
 
+/**
+ * @brief Size of a serialized `struct StarChunk` of a file with
+ *     @a codec and @a flags, in bytes
+ */
+#define STAR_CHUNK_SIZE(codec, flags) \
+        (sizeof(u64) + sizeof(u32) \
+         + (((codec) != STAR_CODEC_NONE) ? sizeof(u32) : 0) \
+         + (((flags) & STAR_F_CHUNK_CHECKSUM) ? sizeof(u32) : 0))
+
+/**
+ * @brief Size of a serialized file size, or stored size, with @a version,
+ *     in bytes
+ */
+#define STAR_SIZE_WIDTH(version) (((version) > 7) ? sizeof(u64) : sizeof(u32))
+
+/**
+ * @brief Size of a serialized path length with @a version, in bytes
+ */
+#define STAR_PATH_LEN_WIDTH(version) (((version) > 7) ? sizeof(u16) : sizeof(u8))
+
+/**
+ * @brief Size of the smallest serialized `struct StarFileHeader` of
+ *     version 2 or later, with a path of only the `NULL` byte, in bytes
+ */
+#define STAR_FHEADER_MIN_SIZE (sizeof(u32) + sizeof(u64) + 4 * sizeof(u8))
+
+/**
+ * @brief Size of a serialized `struct StarBlock`, in bytes
+ */
+#define STAR_BLOCK_ENTRY_SIZE (sizeof(u64) + 2 * sizeof(u32) + sizeof(u8))
+
+/**
+ * @brief Alignment of the sections of the headers of a STAR of
+ *     version 9, in bytes
+ */
+#define STAR_MAP_ALIGN 8
+
+/**
+ * @brief Round @a n up to a multiple of `STAR_MAP_ALIGN`
+ */
+#define STAR_MAP_PAD(n) (((n) + STAR_MAP_ALIGN - 1) / STAR_MAP_ALIGN * STAR_MAP_ALIGN)
+
+/**
+ * @brief Padding of the STAR header of version 9, between the size of
+ *     the dictionary and the size of the headers, in bytes
+ */
+#define STAR_MAP_HEADER_PAD 7
+
+/**
+ * @brief Read the @a field of the @a type at @a p, as in a STAR of
+ *     version 9
+ */
+#define _star_map_get(p, type, field) \
+        _star_map_uint((const u8 *) (p) + offsetof(type, field), sizeof(((type *) 0)->field))
+
+/**
+ * @brief Write @a v to the @a field of the @a type at @a p, as in a STAR
+ *     of version 9
+ */
+#define _star_map_set(p, type, field, v) \
+        _star_uint_width_encode((u8 *) (p) + offsetof(type, field), (v), sizeof(((type *) 0)->field))
+
+/* the records are stored as they are laid out */
+_Static_assert(sizeof(struct StarMapDir) == 16, "struct StarMapDir has padding");
+_Static_assert(sizeof(struct StarRecord) == 56, "struct StarRecord has padding");
+_Static_assert(sizeof(struct StarChunkRecord) == 24, "struct StarChunkRecord has padding");
+_Static_assert(sizeof(struct StarBlockRecord) == 24, "struct StarBlockRecord has padding");
+_Static_assert(sizeof(struct StarSparse) == 16, "struct StarSparse has padding");
+_Static_assert(sizeof(struct StarRun) == 16, "struct StarRun has padding");
+
 /***********************************************************
  * utility functions
  **********************************************************/
@@ -49,16 +140,272 @@ static inline bool _star_check_ptrs (const struct STAR * self)
     ifjmp(self->fheaders == NULL, out);
     ifjmp(self->fdata == NULL, out);
 
-    ret = true;
+    ret = (self->header.nblocks == 0
+            || (self->blocks != NULL && self->bdata != NULL))
+        && (self->header.dsize == 0 || self->dict != NULL);
 
+    /* files that share data have none of their own */
     for (u64 i = 0; i < self->header.nfiles && ret; i++)
         ret = self->fheaders[i].path != NULL
-            && self->fdata[i] != NULL;
+            && (self->fdata[i] != NULL
+                    || (self->same != NULL && self->same[i] != i));
+
+    for (u64 i = 0; i < self->header.nblocks && ret; i++)
+        ret = self->bdata[i] != NULL || self->blocks[i].size == 0;
 
 out:
     return ret;
 }
 
+/**
+ * @brief Find the oldest version of the format that can hold @a self
+ * @param self The STAR
+ * @returns The version
+ */
+static u8 _star_version (const struct STAR * self)
+{
+    if (self->appendable)
+        return 11;
+
+    for (u64 i = 0; i < self->header.nfiles; i++)
+        if (self->fheaders[i].flags & STAR_F_SPARSE)
+            return 10;
+
+    if (self->mappable)
+        return 9;
+
+    for (u64 i = 0; i < self->header.nfiles; i++)
+        if (self->fheaders[i].size > UINT32_MAX
+                || self->fheaders[i].path_len > UCHAR_MAX)
+            return 8;
+
+    for (u64 i = 0; i < self->header.nfiles; i++)
+        if (self->fheaders[i].flags & STAR_F_CHUNK_CHECKSUM)
+            return 7;
+
+    /* checksummed files come with a checksummed header */
+    for (u64 i = 0; i < self->header.nfiles; i++)
+        if (self->fheaders[i].flags & STAR_F_CHECKSUM)
+            return 6;
+
+    if (self->header.dsize > 0)
+        return 4;
+
+    if (self->header.nblocks > 0)
+        return 3;
+
+    for (u64 i = 0; i < self->header.nfiles; i++)
+        if (self->fheaders[i].flags != 0
+                || self->fheaders[i].codec != STAR_CODEC_NONE)
+            return 2;
+
+    /* version 1 readers assume data is packed */
+    if (self->align > 1)
+        return 2;
+
+    return 1;
+}
+
+/**
+ * @brief Calculate the size of a serialized `struct StarHeader`
+ * @param version Version of the format
+ * @returns The size, in bytes
+ */
+static u64 _star_header_size (u8 version)
+{
+    u64 ret = sizeof(STAR_MAGIC) + sizeof(u32);
+
+    /* `0`, version and the actual number of files */
+    if (version > 1)
+        ret += sizeof(u8) + sizeof(u32);
+
+    /* number of blocks */
+    if (version > 2)
+        ret += sizeof(u32);
+
+    /* size of the dictionary */
+    if (version > 3)
+        ret += sizeof(u32);
+
+    /* padding, so that what comes after it is aligned */
+    if (version > 8)
+        ret += STAR_MAP_HEADER_PAD;
+
+    /* where the headers after it are, and how the data is aligned */
+    if (version > 10)
+        ret += 3 * sizeof(u64);
+
+    /* size of the headers after it and their checksum */
+    if (version > 5)
+        ret += sizeof(u64) + sizeof(u32);
+
+    return ret;
+}
+
+/**
+ * @brief Calculate the size of a serialized `struct StarFileHeader`
+ * @param fh The file header
+ * @param version Version of the format
+ * @returns The size, in bytes
+ */
+static u64 _star_fheader_size (const struct StarFileHeader * fh, u8 version)
+{
+    u64 ret = STAR_SIZE_WIDTH(version) + sizeof(u64)
+        + STAR_PATH_LEN_WIDTH(version) + fh->path_len;
+
+    /* flags and codec */
+    if (version > 1)
+        ret += 2 * sizeof(u8);
+
+    if (fh->flags & STAR_F_CHECKSUM)
+        ret += sizeof(u32);
+
+    if (fh->flags & STAR_F_CHUNKED)
+        ret += sizeof(u32) + (u64) fh->nchunks * STAR_CHUNK_SIZE(fh->codec, fh->flags);
+    else if (fh->flags & STAR_F_SOLID)
+        ret += sizeof(u32);
+    else if (fh->codec != STAR_CODEC_NONE)
+        ret += STAR_SIZE_WIDTH(version);
+
+    return ret;
+}
+
+/**
+ * @brief Where each section of the headers of a STAR of version 9 is,
+ *     from right after the STAR header, in bytes
+ */
+struct _star_map_layout {
+    /** The `struct StarRecord`s, right after the `struct StarMapDir` */
+    u64 records;
+    /** The index of each file, in order of path */
+    u64 names;
+    /** The `struct StarChunkRecord`s */
+    u64 chunks;
+    /** The `struct StarBlockRecord`s */
+    u64 blocks;
+    /** The dictionary */
+    u64 dict;
+    /** The paths */
+    u64 strings;
+    /** Size of all the sections */
+    u64 size;
+};
+
+/**
+ * @brief Lay out the headers of a STAR of version 9
+ * @param self Where to put the layout
+ * @param header The STAR header
+ * @param nchunks Number of chunks of all the files
+ * @param ssize Size of all the paths, in bytes
+ */
+static void _star_map_place (struct _star_map_layout * self, const struct StarHeader * header, u64 nchunks, u64 ssize)
+{
+    self->records = sizeof(struct StarMapDir);
+    self->names   = self->records + (u64) header->nfiles * sizeof(struct StarRecord);
+    self->chunks  = self->names + STAR_MAP_PAD((u64) header->nfiles * sizeof(u32));
+    self->blocks  = self->chunks + nchunks * sizeof(struct StarChunkRecord);
+    self->dict    = self->blocks + (u64) header->nblocks * sizeof(struct StarBlockRecord);
+    self->strings = self->dict + STAR_MAP_PAD((u64) header->dsize);
+    self->size    = self->strings + STAR_MAP_PAD(ssize);
+}
+
+/**
+ * @brief Lay out the headers of @a self as in a STAR of version 9
+ * @param self The STAR, with every file header
+ * @param layout Where to put the layout
+ * @param nchunks Where to put the number of chunks of all the files
+ * @param ssize Where to put the size of all the paths, in bytes
+ */
+static void _star_map_layout_of (const struct STAR * self, struct _star_map_layout * layout, u64 * nchunks, u64 * ssize)
+{
+    *nchunks = 0;
+    *ssize = 0;
+
+    for (u64 i = 0; i < self->header.nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+        if (fh->flags & STAR_F_CHUNKED)
+            *nchunks += fh->nchunks;
+        *ssize += fh->path_len;
+    }
+
+    _star_map_place(layout, &self->header, *nchunks, *ssize);
+}
+
+/**
+ * @brief Calculate the offset of the first archived file's data
+ * @param self The STAR, with every file header
+ * @param version Version of the format
+ * @returns Size of the serialized STAR header, block table, dictionary
+ *     and file headers (only of the STAR header, since version 11), in
+ *     bytes
+ */
+static u64 _star_fdata_offset (const struct STAR * self, u8 version)
+{
+    /* the rest of the headers come after the data */
+    if (version > 10)
+        return _star_header_size(version);
+
+    if (version > 8) {
+        struct _star_map_layout layout;
+        u64 nchunks = 0;
+        u64 ssize = 0;
+        _star_map_layout_of(self, &layout, &nchunks, &ssize);
+        return _star_header_size(version) + layout.size;
+    }
+
+    u64 ret = _star_header_size(version)
+        + (u64) self->header.nblocks * STAR_BLOCK_ENTRY_SIZE
+        + self->header.dsize;
+
+    for (u64 i = 0; i < self->header.nfiles; i++)
+        ret += _star_fheader_size(self->fheaders + i, version);
+
+    return ret;
+}
+
+/**
+ * @brief Calculate the size of the block table, dictionary and file
+ *     headers of @a self
+ * @param self The STAR, with every file header
+ * @param version Version of the format
+ * @returns The size, in bytes
+ */
+static u64 _star_hsize (const struct STAR * self, u8 version)
+{
+    if (version > 8) {
+        struct _star_map_layout layout;
+        u64 nchunks = 0;
+        u64 ssize = 0;
+        _star_map_layout_of(self, &layout, &nchunks, &ssize);
+        return layout.size;
+    }
+
+    return _star_fdata_offset(self, version) - _star_header_size(version);
+}
+
+/**
+ * @brief Calculate the checksum of the STAR header of @a self and of
+ *     the headers after it
+ * @param self The STAR, with the STAR header
+ * @param version Version of the format, 6 or later
+ * @param hdata The serialized block table, dictionary and file headers,
+ *     `self->header.hsize` bytes
+ * @returns The CRC32C of the serialized STAR header, up to the checksum,
+ *     and of @a hdata
+ */
+static u32 _star_header_crc (const struct STAR * self, u8 version, const u8 * hdata)
+{
+    u8 buf[80];
+    Stream hs = {0};
+
+    /* `buf` is never closed, it's not the Stream's to free */
+    u64 hlen = _star_header_size(version) - sizeof(u32);
+    stream_from_raw(&hs, buf, sizeof(buf));
+    star_write_header(self, version, &hs);
+
+    return crc32c(crc32c(0, buf, hlen), hdata, self->header.hsize);
+}
+
 /*
  * `_star_uint_width_encode()` and `_star_uint_width_decode()`
  * from http://www.iso-9899.info/wiki/Temp
@@ -83,7 +430,7 @@ static void _star_uint_width_encode (u8 * out, u64 in, size_t width)
  * @param in The data to deserialize from
  * @param width The witdh of the integer to deserialize
  */
-static void _star_uint_width_decode (u64 * out, u8 * in, size_t width)
+static void _star_uint_width_decode (u64 * out, const u8 * in, size_t width)
 {
     if (width > sizeof(u64)) return;
     *out = 0;
@@ -91,6 +438,20 @@ static void _star_uint_width_decode (u64 * out, u8 * in, size_t width)
         *out |= (u64) in[i] << (i * CHAR_BIT);
 }
 
+/**
+ * @brief Deserialize an unsigned integer with @a width from @a in, that
+ *     may not be aligned
+ * @param in The data to deserialize from
+ * @param width The witdh of the integer to deserialize
+ * @returns The integer
+ */
+static inline u64 _star_map_uint (const u8 * in, size_t width)
+{
+    u64 ret = 0;
+    _star_uint_width_decode(&ret, in, width);
+    return ret;
+}
+
 bool star_check_header (const struct STAR * self)
 {
     return (self != NULL)
@@ -98,88 +459,274 @@ bool star_check_header (const struct STAR * self)
                     sizeof(STAR_MAGIC)) == 0);
 }
 
-//
-// This function works only on certain circumstances.
-//
-// # Use case:
-//
-// Given a directory tree similar to the following:
-//
-//   ```
-//   directory/
-//   ├── file1
-//   ├── file2
-//   ├── file3
-//   ├── file4
-//   ├── file5
-//   ├── file6
-//   ├── file7
-//   ├── file8
-//   ├── file9
-//   ├── file10
-//   └── file11
-//   ```
-//
-// and calling a `program` this way:
-//
-//   ```sh
-//   program directory/*
-//   ```
-//
-// `argv` will look like:
-//
-//   ```c
-//   argv = {
-//       [0]  = "program",
-//       [1]  = "directory/file1",
-//       [2]  = "directory/file10",
-//       [3]  = "directory/file11",
-//       [4]  = "directory/file2",
-//       [5]  = "directory/file3",
-//       [6]  = "directory/file4",
-//       [7]  = "directory/file5",
-//       [8]  = "directory/file6",
-//       [9]  = "directory/file7",
-//       [10] = "directory/file8",
-//       [11] = "directory/file9",
-//   }
-//   ```
-//
-// This isn't ideal if you want to process these files in
-// order.
-//
-// # Assumptions
-//
-// The strings to be compared are composed of common a
-// prefix and a number after that prefix (`pn`). It
-// doesn't matter what the prefix is.
-//
-// e.g.:
-//   pre1 < pre2 < pre10
-//
-// # Limitations
-//
-// The numbers aren't read nor compared as numbers, so the
-// same number with a different representation will not
-// give the correct order.
-//
-// e.g.:
-//   1 < 01 < 001
-//   2 < 01 < 000
-//
+/*
+ * Natural order: digit runs compare by their numeric value (and, if
+ * equal, the one with fewer leading zeros goes first), everything else
+ * byte by byte.
+ *
+ * e.g.:
+ *   pre1 < pre2 < pre10 < pre010
+ *
+ * `_star_natkey()` encodes a string into a key such that comparing keys
+ * with `memcmp()` (and then by length) gives the same order as
+ * `star_strcmp()` on the strings; digit runs become the number of
+ * significant digits, the significant digits, and the number of
+ * leading zeros. The numbers are encoded with `_star_natkey_num()` and
+ * always start with a byte in '0'...'9', so that a digit run compares
+ * with any other byte the same way its first digit would.
+ */
+
+#define _star_isdigit(c) ((c) >= '0' && (c) <= '9')
+
+/**
+ * @brief Encode @a v as part of a natural order key
+ * @param out Where to write the encoding, or `NULL` to only measure it
+ * @param v The number to encode
+ * @returns Number of bytes of the encoding
+ */
+static size_t _star_natkey_num (u8 * out, size_t v)
+{
+    if (v < 9) {
+        if (out != NULL)
+            out[0] = (u8) ('0' + v);
+        return 1;
+    }
+
+    if (v > UINT32_MAX)
+        v = UINT32_MAX;
+
+    if (out != NULL) {
+        out[0] = '9';
+        for (size_t i = 0; i < 4; i++)
+            out[1 + i] = (u8) (v >> ((3 - i) * CHAR_BIT));
+    }
+
+    return 5;
+}
+
+/**
+ * @brief Encode @a str as a natural order key
+ * @param out Where to write the key, or `NULL` to only measure it
+ * @param str The string
+ * @returns Length of the key, in bytes
+ */
+static size_t _star_natkey (u8 * out, const u8 * str)
+{
+    size_t ret = 0;
+
+    while (*str != '\0') {
+        if (!_star_isdigit(*str)) {
+            if (out != NULL)
+                out[ret] = *str;
+            ret++;
+            str++;
+            continue;
+        }
+
+        const u8 * zeros = str;
+        while (*str == '0')
+            str++;
+
+        const u8 * digits = str;
+        while (_star_isdigit(*str))
+            str++;
+
+        size_t nzeros = (size_t) (digits - zeros);
+        size_t ndigits = (size_t) (str - digits);
+
+        ret += _star_natkey_num((out != NULL) ? out + ret : NULL, ndigits);
+        if (out != NULL)
+            memcpy(out + ret, digits, ndigits);
+        ret += ndigits;
+        ret += _star_natkey_num((out != NULL) ? out + ret : NULL, nzeros);
+    }
+
+    return ret;
+}
+
 int star_strcmp (const void * _l, const void * _r)
 {
-    const char * l = _l;
-    const char * r = _r;
+    const u8 * l = _l;
+    const u8 * r = _r;
+
+    while (*l != '\0' && *r != '\0') {
+        if (!_star_isdigit(*l) || !_star_isdigit(*r)) {
+            if (*l != *r)
+                return (*l < *r) ? -1 : 1;
+            l++;
+            r++;
+            continue;
+        }
+
+        const u8 * lz = l;
+        const u8 * rz = r;
+        while (*l == '0') l++;
+        while (*r == '0') r++;
+
+        const u8 * ld = l;
+        const u8 * rd = r;
+        while (_star_isdigit(*l)) l++;
+        while (_star_isdigit(*r)) r++;
+
+        /* more significant digits, bigger number */
+        size_t nl = (size_t) (l - ld);
+        size_t nr = (size_t) (r - rd);
+        if (nl != nr)
+            return (nl < nr) ? -1 : 1;
+
+        int cmp = memcmp(ld, rd, nl);
+        if (cmp != 0)
+            return cmp;
+
+        /* same number, fewer leading zeros first */
+        size_t zl = min((size_t) (ld - lz), (size_t) UINT32_MAX);
+        size_t zr = min((size_t) (rd - rz), (size_t) UINT32_MAX);
+        if (zl != zr)
+            return (zl < zr) ? -1 : 1;
+    }
+
+    return (*l > *r) - (*l < *r);
+}
+
+/**
+ * @brief Minimum number of strings for `star_sort()` to use a radix sort
+ */
+#define STAR_SORT_RADIX_MIN 4096
+
+/**
+ * @brief A string decorated with its natural order key
+ */
+struct _star_natkey {
+    /** The key */
+    const u8 * key;
+    /** Length of `key`, in bytes */
+    size_t len;
+    /** The string */
+    char * str;
+};
+
+static int _star_natkey_cmp (const void * _l, const void * _r)
+{
+    const struct _star_natkey * l = _l;
+    const struct _star_natkey * r = _r;
+
+    int cmp = memcmp(l->key, r->key, min(l->len, r->len));
+    return (cmp != 0) ?
+        cmp :
+        (l->len > r->len) - (l->len < r->len) ;
+}
+
+static int _star_strcmp_ptr (const void * l, const void * r)
+{
+    return star_strcmp(* (char * const *) l, * (char * const *) r);
+}
+
+/**
+ * @brief MSD radix sort @a v, whose keys are all equal up to @a depth
+ * @param v The keys
+ * @param aux Scratch space with room for @a n keys
+ * @param n Number of keys
+ * @param depth Length of the common prefix of the keys
+ */
+static void _star_msd (struct _star_natkey * v, struct _star_natkey * aux, size_t n, size_t depth)
+{
+    /* bucket 0 is for keys that end at `depth`, then one per byte */
+#define bucket(k) (((k).len > depth) ? (size_t) (k).key[depth] + 1 : 0)
+    size_t start[UCHAR_MAX + 3];
+
+    while (n >= STAR_SORT_RADIX_MIN / 64) {
+        memset(start, 0, sizeof(start));
+        for (size_t i = 0; i < n; i++)
+            start[bucket(v[i]) + 1]++;
+
+        /* a common byte, no need to move anything */
+        if (start[bucket(v[0]) + 1] == n) {
+            if (bucket(v[0]) == 0)
+                return;
+            depth++;
+            continue;
+        }
+
+        for (size_t b = 1; b < UCHAR_MAX + 3; b++)
+            start[b] += start[b - 1];
+
+        for (size_t i = 0; i < n; i++)
+            aux[start[bucket(v[i])]++] = v[i];
+        memcpy(v, aux, n * sizeof(struct _star_natkey));
+
+        /*
+         * `start[b]` is now the end of bucket `b`; all but the biggest
+         * bucket are sorted recursively, each at most half of `n`, so
+         * that it never goes deeper than `log2(n)`, and the biggest here
+         */
+        size_t bfrom = 0;
+        size_t bn = 0;
+        for (size_t b = 1, from = start[0]; b < UCHAR_MAX + 2; from = start[b], b++) {
+            size_t len = start[b] - from;
+            if (len > bn) {
+                if (bn > 1)
+                    _star_msd(v + bfrom, aux, bn, depth + 1);
+                bfrom = from;
+                bn = len;
+            } else if (len > 1) {
+                _star_msd(v + from, aux, len, depth + 1);
+            }
+        }
+
+        v += bfrom;
+        n = bn;
+        depth++;
+    }
+#undef bucket
+
+    qsort(v, n, sizeof(struct _star_natkey), _star_natkey_cmp);
+}
+
+void star_sort (char ** strs, size_t n)
+{
+    struct _star_natkey * v = NULL;
+    struct _star_natkey * aux = NULL;
+    u8 * keys = NULL;
+
+    ifjmp(strs == NULL, out);
+    ifjmp(n < 2, out);
+
+    v = malloc(n * sizeof(struct _star_natkey));
+    ifjmp(v == NULL, ko);
+
+    size_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        v[i].str = strs[i];
+        v[i].len = _star_natkey(NULL, (u8 *) strs[i]);
+        total += v[i].len;
+    }
+
+    keys = malloc(total + 1);
+    ifjmp(keys == NULL, ko);
 
-    /* `l.len == r.len` <=> `l.len - r.len == 0` */
-    size_t nl = strlen(l);
-    size_t nr = strlen(r);
-    int diff = nl - nr;
+    for (size_t i = 0, off = 0; i < n; off += v[i].len, i++) {
+        v[i].key = keys + off;
+        _star_natkey(keys + off, (u8 *) strs[i]);
+    }
+
+    if (n >= STAR_SORT_RADIX_MIN
+            && (aux = malloc(n * sizeof(struct _star_natkey))) != NULL)
+        _star_msd(v, aux, n, 0);
+    else
+        qsort(v, n, sizeof(struct _star_natkey), _star_natkey_cmp);
+
+    for (size_t i = 0; i < n; i++)
+        strs[i] = v[i].str;
+
+out:
+    free(aux);
+    free(keys);
+    free(v);
+    return;
 
-    return (diff == 0) ?
-        strcmp(l, r) :
-        diff ;
+ko: /* not enough memory for keys, sort the slow way */
+    qsort(strs, n, sizeof(char *), _star_strcmp_ptr);
+    goto out;
 }
 
 void star_free (struct STAR * self)
@@ -190,9 +737,10 @@ void star_free (struct STAR * self)
     u64 n = self->header.nfiles;
 
     if (self->fheaders != NULL) {
-        for (u64 i = 0; i < n; i++)
-            if (self->fheaders[i].path != NULL)
-                free(self->fheaders[i].path);
+        for (u64 i = 0; i < n; i++) {
+            free(self->fheaders[i].path);
+            free(self->fheaders[i].chunks);
+        }
 
         free(self->fheaders);
     }
@@ -205,6 +753,24 @@ void star_free (struct STAR * self)
         free(self->fdata);
     }
 
+    if (self->cdata != NULL) {
+        for (u64 i = 0; i < n; i++)
+            free(self->cdata[i]);
+
+        free(self->cdata);
+    }
+
+    if (self->bdata != NULL) {
+        for (u64 i = 0; i < self->header.nblocks; i++)
+            free(self->bdata[i]);
+
+        free(self->bdata);
+    }
+
+    free(self->blocks);
+    free(self->bcache);
+    free(self->dict);
+    free(self->same);
     free(self);
 }
 
@@ -241,7 +807,26 @@ _star_make_read_fun(star_read_u64, u64);
 
 /* read SIZE bytes from OUT int IN, as if they were a single unit */
 #define star_read_u8_single(OUT, IN, SIZE) \
-        (stream_read((IN), (OUT), (SIZE), 1) == 1)
+        ((SIZE) == 0 || stream_read((IN), (OUT), (SIZE), 1) == 1)
+
+/**
+ * @brief Read an unsigned integer with @a width from @a in to @a out,
+ *     for fields whose width depends on the version
+ * @param out Where to read to
+ * @param width The width of the integer, in bytes
+ * @param in The Stream
+ * @returns `true` if it was read, `false` otherwise
+ */
+static bool _star_read_uint (u64 * out, size_t width, Stream * in)
+{
+    u8 buf[sizeof(u64)] = {0};
+
+    if (width > sizeof(u64) || !star_read_u8_single(buf, in, width))
+        return false;
+
+    _star_uint_width_decode(out, buf, width);
+    return true;
+}
 
 bool star_read_header (struct STAR * self, Stream * in)
 {
@@ -251,350 +836,4111 @@ bool star_read_header (struct STAR * self, Stream * in)
     ifjmp(in == NULL, out);
 
     struct STAR tmp = {0};
+    u64 pad = 0;
 
     ret =  star_read_u8_single(&tmp.header.magic, in, sizeof(STAR_MAGIC))
         && star_check_header(&tmp)
         && star_read_u32(&tmp.header.nfiles, in, 1);
+    ifjmp(!ret, out);
+
+    tmp.header.version = 1;
+
+    /* versioned STARs have `0` files, as far as version 1 is concerned */
+    if (tmp.header.nfiles == 0)
+        ret =  star_read_u8(&tmp.header.version, in, 1)
+            && tmp.header.version > 1
+            && tmp.header.version <= STAR_VERSION
+            && star_read_u32(&tmp.header.nfiles, in, 1)
+            && (tmp.header.version < 3
+                    || star_read_u32(&tmp.header.nblocks, in, 1))
+            && (tmp.header.version < 4
+                    || star_read_u32(&tmp.header.dsize, in, 1))
+            && (tmp.header.version < 9
+                    || (_star_read_uint(&pad, STAR_MAP_HEADER_PAD, in)
+                        && pad == 0))
+            && (tmp.header.version < 11
+                    || (star_read_u64(&tmp.header.hoffset, in, 1)
+                        && star_read_u64(&tmp.header.align, in, 1)
+                        && star_read_u64(&tmp.header.align_min, in, 1)))
+            && (tmp.header.version < 6
+                    || (star_read_u64(&tmp.header.hsize, in, 1)
+                        && star_read_u32(&tmp.header.hcrc, in, 1)));
+
+    /* right after it, before version 11 */
+    if (tmp.header.version < 11)
+        tmp.header.hoffset = _star_header_size(tmp.header.version);
+
+    if (ret)
+        self->header = tmp.header;
 
-    self->header = tmp.header;
-    ret = true;
 out:
     return ret;
 }
 
-bool star_read_fheader (struct StarFileHeader * fheader, Stream * in)
+bool star_read_blocks (struct STAR * self, Stream * in)
 {
     bool ret = false;
 
-    ifjmp(fheader == NULL, ko);
-    ifjmp(in == NULL, ko);
+    ifjmp(self == NULL, out);
+    ifjmp(in == NULL, out);
 
-    ret =  star_read_u32(&fheader->size,    in, 1)
-        && star_read_u64(&fheader->offset,  in, 1)
-        && star_read_u8(&fheader->path_len, in, 1);
+    u64 nblocks = self->header.nblocks;
 
-    ifjmp(!ret, ko);
+    ret = nblocks == 0;
+    ifjmp(ret, out);
 
-    fheader->path = malloc(fheader->path_len);
-    ifjmp(fheader->path == NULL, ko);
+    struct StarBlock * blocks = calloc(nblocks, sizeof(struct StarBlock));
+    ifjmp(blocks == NULL, out);
 
-    if (!star_read_u8_single(fheader->path, in, fheader->path_len)) {
-        free(fheader->path);
-        fheader->path = NULL;
+    ret = true;
+    for (u64 i = 0; i < nblocks && ret; i++) {
+        struct StarBlock * b = blocks + i;
+
+        /* data is never stored bigger than it is */
+        ret =  star_read_u64(&b->offset, in, 1)
+            && star_read_u32(&b->size,   in, 1)
+            && star_read_u32(&b->csize,  in, 1)
+            && star_read_u8(&b->codec,   in, 1)
+            && b->csize <= b->size
+            && b->codec <= STAR_CODEC_LZ_DICT;
     }
 
-ko:
+    if (ret) {
+        free(self->blocks);
+        self->blocks = blocks;
+    } else {
+        free(blocks);
+    }
+
+out:
     return ret;
 }
 
-u64 star_read_fheaders (struct STAR * self, Stream * in)
+bool star_read_dict (struct STAR * self, Stream * in)
 {
-    u64 ret = 0;
+    bool ret = false;
 
     ifjmp(self == NULL, out);
     ifjmp(in == NULL, out);
 
-    u64 nfiles = self->header.nfiles;
+    u32 dsize = self->header.dsize;
 
-    /* if fheaders already has memory, use it */
-    struct StarFileHeader * fheaders = (self->fheaders == NULL) ?
-        calloc(self->header.nfiles, sizeof(struct StarFileHeader)) :
-        self->fheaders ;
-    ifjmp(fheaders == NULL, out);
+    ret = dsize == 0;
+    ifjmp(ret, out);
 
-    /* assume `fheaders` has enough space  */
-    for (ret = 0; ret < nfiles; ret++) {
-        struct StarFileHeader tmp = {0};
+    u8 * dict = malloc(dsize);
+    ifjmp(dict == NULL, out);
 
-        /* wasnt able to read the fheader? */
-        if (!star_read_fheader(&tmp, in))
-            break;
+    ret = star_read_u8_single(dict, in, dsize);
 
-        fheaders[ret] = tmp;
+    if (ret) {
+        free(self->dict);
+        self->dict = dict;
+    } else {
+        free(dict);
     }
 
-    self->fheaders = fheaders;
-
 out:
     return ret;
 }
 
-u64 star_read_fdata (struct STAR * self, Stream * in)
+bool star_read_fheader (struct StarFileHeader * fheader, u8 version, Stream * in)
+{
+    bool ret = false;
+
+    ifjmp(fheader == NULL, out);
+    ifjmp(in == NULL, out);
+
+    struct StarFileHeader tmp = {0};
+    u64 path_len = 0;
+
+    ret =  _star_read_uint(&tmp.size, STAR_SIZE_WIDTH(version), in)
+        && star_read_u64(&tmp.offset, in, 1)
+        && _star_read_uint(&path_len, STAR_PATH_LEN_WIDTH(version), in);
+    ifjmp(!ret, out);
+
+    tmp.path_len = (u16) path_len;
+
+    /* paths are `NULL` terminated */
+    tmp.path = malloc(tmp.path_len);
+    ret = tmp.path != NULL
+        && star_read_u8_single(tmp.path, in, tmp.path_len)
+        && tmp.path_len > 0
+        && tmp.path[tmp.path_len - 1] == '\0'
+        && (version < 2
+                || (star_read_u8(&tmp.flags, in, 1)
+                    && star_read_u8(&tmp.codec, in, 1)
+                    && tmp.codec <= STAR_CODEC_LZ_DICT));
+    ifjmp(!ret, ko);
+
+    if (tmp.flags & STAR_F_CHECKSUM) {
+        ret =  version > 4
+            && star_read_u32(&tmp.crc, in, 1);
+        ifjmp(!ret, ko);
+    }
+
+    /* chunk checksums are only of chunks, and make the file's */
+    bool ccrc = (tmp.flags & STAR_F_CHUNK_CHECKSUM) != 0;
+    ret = !ccrc
+        || (version > 6
+                && (tmp.flags & STAR_F_CHUNKED)
+                && (tmp.flags & STAR_F_CHECKSUM));
+    ifjmp(!ret, ko);
+
+    /* sparse files are only since version 10, and deleted ones since 11 */
+    ret = !(tmp.flags & (STAR_F_SPARSE | STAR_F_DELETED));
+    ifjmp(!ret, ko);
+
+    bool codec = tmp.codec != STAR_CODEC_NONE;
+
+    /* data is never stored bigger than it is */
+    tmp.csize = tmp.size;
+    if (tmp.flags & STAR_F_SOLID) {
+        ret =  !(tmp.flags & STAR_F_CHUNKED)
+            && star_read_u32(&tmp.block, in, 1);
+        ifjmp(!ret, ko);
+    } else if (codec && !(tmp.flags & STAR_F_CHUNKED)) {
+        ret =  _star_read_uint(&tmp.csize, STAR_SIZE_WIDTH(version), in)
+            && tmp.csize <= tmp.size;
+        ifjmp(!ret, ko);
+    }
+
+    if (tmp.flags & STAR_F_CHUNKED) {
+        /* chunks are never empty */
+        ret =  star_read_u32(&tmp.nchunks, in, 1)
+            && tmp.nchunks <= tmp.size;
+        ifjmp(!ret, ko);
+
+        tmp.chunks = calloc(tmp.nchunks, sizeof(struct StarChunk));
+        ret = tmp.nchunks == 0 || tmp.chunks != NULL;
+
+        u64 size = 0;
+        for (u32 i = 0; i < tmp.nchunks && ret; i++) {
+            struct StarChunk * c = tmp.chunks + i;
+
+            ret =  star_read_u64(&c->offset, in, 1)
+                && star_read_u32(&c->size,   in, 1);
+
+            c->csize = c->size;
+            ret = ret && (!codec
+                    || (star_read_u32(&c->csize, in, 1)
+                        && c->csize <= c->size));
+            ret = ret && (!ccrc || star_read_u32(&c->crc, in, 1));
+
+            c->start = size;
+            size += c->size;
+        }
+
+        ret = ret && size == tmp.size;
+        ifjmp(!ret, ko);
+    }
+
+    *fheader = tmp;
+
+out:
+    return ret;
+
+ko:
+    free(tmp.path);
+    free(tmp.chunks);
+    ret = false;
+    goto out;
+}
+
+u64 star_read_fheaders (struct STAR * self, Stream * in)
+{
+    u64 ret = 0;
+
+    ifjmp(self == NULL, out);
+    ifjmp(in == NULL, out);
+
+    u64 nfiles = self->header.nfiles;
+
+    /* if fheaders already has memory, use it */
+    struct StarFileHeader * fheaders = (self->fheaders == NULL) ?
+        calloc(self->header.nfiles, sizeof(struct StarFileHeader)) :
+        self->fheaders ;
+    ifjmp(fheaders == NULL, out);
+
+    /* assume `fheaders` has enough space  */
+    for (ret = 0; ret < nfiles; ret++) {
+        struct StarFileHeader tmp = {0};
+
+        /* wasnt able to read the fheader? */
+        if (!star_read_fheader(&tmp, self->header.version, in))
+            break;
+
+        /* solid files have to be in their block */
+        if ((tmp.flags & STAR_F_SOLID)
+                && (tmp.block >= self->header.nblocks
+                    || self->blocks == NULL
+                    || tmp.offset > self->blocks[tmp.block].size
+                    || tmp.size > self->blocks[tmp.block].size - tmp.offset)) {
+            free(tmp.path);
+            free(tmp.chunks);
+            break;
+        }
+
+        fheaders[ret] = tmp;
+    }
+
+    self->fheaders = fheaders;
+
+    /*
+     * version 1 STARs written before offsets were honoured have them
+     * all wrong, but their data is always packed in order; and the
+     * first file's data always comes right after the file headers
+     */
+    u64 offset = (ret == nfiles && self->header.version == 1) ?
+        _star_fdata_offset(self, self->header.version) :
+        0 ;
+    if (offset > 0 && nfiles > 0 && fheaders[0].offset != offset) {
+        for (u64 i = 0; i < nfiles; i++) {
+            fheaders[i].offset = offset;
+            offset += fheaders[i].size;
+        }
+    }
+
+out:
+    return ret;
+}
+
+/**
+ * @brief Data already read by `star_read_fdata()`
+ */
+struct _star_read_seg {
+    /** Offset from the beggining of the STAR to the beggining of the data */
+    u64 offset;
+    /** Size of the data as stored, in bytes */
+    u64 csize;
+    /** Size of the data, in bytes */
+    u64 size;
+    /** The data */
+    const u8 * data;
+    /** Index of the file the data is from */
+    u64 file;
+    /** The chunk the data is from, `NULL` if the whole file */
+    const struct StarChunk * chunk;
+};
+
+/**
+ * @brief State of `star_read_fdata()`
+ */
+struct _star_read {
+    /** The STAR */
+    const struct STAR * star;
+    /** Where to read data from */
+    Stream * in;
+    /** Offset from the beggining of the STAR to where `in` is */
+    u64 pos;
+    /** Data already read, in order of offset */
+    struct _star_read_seg * segs;
+    /** Number of elements of `segs` */
+    u64 nsegs;
+    /** Solid blocks already read, decoded */
+    u8 ** blocks;
+    /** Number of solid blocks already read */
+    u64 nblocks;
+};
+
+/**
+ * @brief Make sure @a buf has room for @a size bytes
+ * @param buf The buffer, reallocated if needed
+ * @param cap Size of @a buf, in bytes, updated
+ * @param size Size needed, in bytes
+ * @returns `true` if @a buf has room, `false` otherwise
+ */
+static bool _star_buf_reserve (u8 ** buf, u64 * cap, u64 size)
+{
+    if (size <= *cap)
+        return true;
+
+    u8 * tmp = realloc(*buf, size);
+    if (tmp == NULL)
+        return false;
+
+    *buf = tmp;
+    *cap = size;
+    return true;
+}
+
+/**
+ * @brief Decode @a csize bytes of @a in to @a size bytes of @a out
+ * @param star The STAR, with its dictionary
+ * @param codec The codec the data is stored with
+ * @param in The data as stored
+ * @param csize Size of the data as stored, in bytes
+ * @param out Where to decode to
+ * @param size Size of the data, in bytes
+ * @returns `true` if the data was decoded, `false` if it's corrupt
+ */
+static bool _star_decode (const struct STAR * star, u8 codec, const u8 * in, u64 csize, u8 * out, u64 size)
+{
+    /* data that didn't get any smaller is stored as is */
+    if (csize == size) {
+        memcpy(out, in, size);
+        return true;
+    }
+
+    switch (codec) {
+        case STAR_CODEC_LZ:      return lz_decompress(in, csize, out, size);
+        case STAR_CODEC_LZ_DICT: return lz_decompress_dict(star->dict, star->header.dsize, in, csize, out, size);
+        default:                 return false;
+    }
+}
+
+/**
+ * @brief Skip the padding before data at @a offset, if it comes next
+ * @param self State of `star_read_fdata()`
+ * @param offset Offset of the data
+ * @returns `true` if the data at @a offset comes next, and `in` is
+ *     there, `false` otherwise
+ *
+ * The padding is read, not seeked over, so that pipes work too.
+ */
+static bool _star_read_skip (struct _star_read * self, u64 offset)
+{
+    u8 buf[1 << 12];
+
+    if (offset < self->pos)
+        return false;
+
+    while (self->pos < offset) {
+        u64 n = min(offset - self->pos, (u64) sizeof(buf));
+        if (!star_read_u8_single(buf, self->in, n))
+            return false;
+        self->pos += n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Read @a size bytes at @a offset to @a out, either from the
+ *     Stream, if that's where it is, or from the data already read
+ * @param self State of `star_read_fdata()`
+ * @param out Where to read to
+ * @param stored Where to keep the data as stored, if read from the
+ *     Stream, `NULL` if it has no codec
+ * @param codec The codec the data is stored with
+ * @param offset Offset of the data
+ * @param csize Size of the data as stored, in bytes
+ * @param size Size of the data, in bytes
+ * @param seg What the data is; saved for later reads, if read from
+ *     the Stream, or set to the data already read
+ * @returns `true` if the data was read, `false` otherwise
+ */
+static bool _star_read_data (struct _star_read * self, u8 * out, u8 * stored, u8 codec, u64 offset, u64 csize, u64 size, struct _star_read_seg * seg)
+{
+    /* data not read yet comes after what was, maybe padded */
+    if (offset >= self->pos) {
+        if (!_star_read_skip(self, offset))
+            return false;
+
+        if (stored == NULL) {
+            if (!star_read_u8_single(out, self->in, size))
+                return false;
+        } else if (!star_read_u8_single(stored, self->in, csize)
+                || !_star_decode(self->star, codec, stored, csize, out, size)) {
+            return false;
+        }
+
+        self->pos += csize;
+        seg->offset = offset;
+        seg->csize = csize;
+        seg->size = size;
+        seg->data = out;
+        self->segs[self->nsegs++] = *seg;
+        return true;
+    }
+
+    /* last data read starting at or before `offset` */
+    u64 lo = 0;
+    u64 hi = self->nsegs;
+    while (lo < hi) {
+        u64 mid = lo + (hi - lo) / 2;
+        if (self->segs[mid].offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* STARs only ever share whole files or whole chunks */
+    if (lo == 0
+            || self->segs[lo - 1].offset != offset
+            || self->segs[lo - 1].csize != csize
+            || self->segs[lo - 1].size != size)
+        return false;
+
+    *seg = self->segs[lo - 1];
+    memcpy(out, seg->data, size);
+    return true;
+}
+
+/**
+ * @brief Make sure the solid block @a b was read, from the Stream if
+ *     it wasn't yet
+ * @param self State of `star_read_fdata()`
+ * @param star The STAR
+ * @param b Index of the block
+ * @returns `true` if the block was read, `false` otherwise
+ */
+static bool _star_read_block (struct _star_read * self, struct STAR * star, u32 b)
+{
+    if (b < self->nblocks)
+        return true;
+
+    /* blocks are stored in order of their first file */
+    const struct StarBlock * blk = star->blocks + b;
+    if (b != self->nblocks || !_star_read_skip(self, blk->offset))
+        return false;
+
+    u8 * stored = star->bdata[b] = malloc(blk->csize);
+    u8 * data = self->blocks[b] = malloc(blk->size);
+    self->nblocks++;
+
+    if ((stored == NULL && blk->csize > 0)
+            || (data == NULL && blk->size > 0)
+            || !star_read_u8_single(stored, self->in, blk->csize)
+            || !_star_decode(star, blk->codec, stored, blk->csize, data, blk->size))
+        return false;
+
+    self->pos += blk->csize;
+    return true;
+}
+
+u64 star_read_fdata (struct STAR * self, Stream * in)
+{
+    u64 ret = 0;
+    struct _star_read rd = { .star = self, .in = in };
+
+    ifjmp(self == NULL, out);
+    ifjmp(in == NULL, out);
+    ifjmp(self->fheaders == NULL, out);
+
+    u64 nfiles = self->header.nfiles;
+
+    /* at most one read per file, or per chunk */
+    u64 nsegs = 0;
+    for (u64 i = 0; i < nfiles; i++)
+        nsegs += (self->fheaders[i].flags & STAR_F_CHUNKED) ?
+            self->fheaders[i].nchunks :
+            1 ;
+
+    rd.segs = malloc(nsegs * sizeof(struct _star_read_seg));
+    ifjmp(rd.segs == NULL && nsegs > 0, out);
+
+    u8 ** fdata = (self->fdata == NULL) ?
+        calloc(nfiles, sizeof(u8 *)) :
+        self->fdata ;
+    ifjmp(fdata == NULL, out);
+    self->fdata = fdata;
+
+    /* keep compressed data as is, to write it back the same way */
+    bool codec = false;
+    for (u64 i = 0; i < nfiles && !codec; i++)
+        codec = self->fheaders[i].codec != STAR_CODEC_NONE;
+
+    if (codec && self->cdata == NULL) {
+        self->cdata = calloc(nfiles, sizeof(u8 *));
+        ifjmp(self->cdata == NULL, out);
+    }
+
+    u64 nblocks = self->header.nblocks;
+    if (nblocks > 0) {
+        rd.blocks = calloc(nblocks, sizeof(u8 *));
+        ifjmp(rd.blocks == NULL, out);
+
+        if (self->bdata == NULL)
+            self->bdata = calloc(nblocks, sizeof(u8 *));
+        ifjmp(self->bdata == NULL, out);
+    }
+
+    rd.pos = _star_fdata_offset(self, self->header.version);
+
+    /* since version 11, the data is before the headers, just read */
+    ifjmp(self->header.version > 10 && !stream_seek(in, rd.pos), out);
+
+    /* assume `fdata` has enough space */
+    for (ret = 0; ret < nfiles; ret++) {
+        struct StarFileHeader * fh = self->fheaders + ret;
+        struct _star_read_seg seg = { .file = ret };
+
+        fdata[ret] = malloc(fh->size);
+        if (fdata[ret] == NULL)
+            break;
+
+        /* never bigger than the data */
+        u8 * cdata = NULL;
+        if (fh->codec != STAR_CODEC_NONE && !(fh->flags & STAR_F_SOLID)) {
+            cdata = self->cdata[ret] = malloc(fh->size);
+            if (cdata == NULL && fh->size > 0)
+                break;
+        }
+
+        bool ok = true;
+
+        if (fh->flags & STAR_F_SOLID) {
+            ok = _star_read_block(&rd, self, fh->block);
+            if (ok)
+                memcpy(fdata[ret], rd.blocks[fh->block] + fh->offset, fh->size);
+        } else if (fh->flags & STAR_F_CHUNKED) {
+            u64 off = 0;
+            u64 coff = 0;
+
+            for (u32 i = 0; i < fh->nchunks && ok; i++) {
+                struct StarChunk * c = fh->chunks + i;
+
+                seg.chunk = c;
+                ok = _star_read_data(&rd, fdata[ret] + off,
+                        (cdata != NULL) ? cdata + coff : NULL, fh->codec,
+                        c->offset, c->csize, c->size, &seg);
+                off += c->size;
+
+                /* only chunks read just now are kept as stored */
+                if (ok && seg.chunk == c)
+                    coff += c->csize;
+
+                /* remember what's shared, to write it back the same way */
+                if (ok && seg.chunk != c)
+                    c->same = seg.chunk;
+                ok = ok && (seg.chunk != NULL);
+            }
+        } else {
+            seg.chunk = NULL;
+            ok = _star_read_data(&rd, fdata[ret], cdata, fh->codec,
+                    fh->offset, fh->csize, fh->size, &seg)
+                && seg.chunk == NULL;
+
+            if (ok && seg.file != ret) {
+                if (self->same == NULL) {
+                    self->same = malloc(nfiles * sizeof(u32));
+                    ok = self->same != NULL;
+                    for (u64 i = 0; ok && i < nfiles; i++)
+                        self->same[i] = (u32) i;
+                }
+
+                if (ok)
+                    self->same[ret] = (u32) seg.file;
+            }
+        }
+
+        ok = ok
+            && (!(fh->flags & STAR_F_CHECKSUM)
+                    || crc32c(0, fdata[ret], fh->size) == fh->crc);
+
+        if (!ok) {
+            free(fdata[ret]);
+            fdata[ret] = NULL;
+            break;
+        }
+    }
+
+out:
+    for (u64 i = 0; i < rd.nblocks; i++)
+        free(rd.blocks[i]);
+    free(rd.blocks);
+    free(rd.segs);
+    return ret;
+}
+
+/**
+ * @brief Read the block table, dictionary and file headers of @a self
+ *     from @a in at once, and check them against the STAR header
+ * @param self The STAR, with the STAR header, version 6 or later
+ * @param in A Stream positioned right after the STAR header
+ * @returns The `self->header.hsize` bytes read, or `NULL` if they
+ *     couldn't be read or don't match the checksum
+ *
+ * Only what was read so far is ever allocated, so a damaged size fails
+ * at the end of @a in, and not on a huge allocation.
+ */
+static u8 * _star_read_hdata (const struct STAR * self, Stream * in)
+{
+    u64 hsize = self->header.hsize;
+    u64 size = 0;
+
+    /* headers can't be smaller than their fixed size parts */
+    bool ok = hsize >= (u64) self->header.nblocks * STAR_BLOCK_ENTRY_SIZE
+            + self->header.dsize
+            + (u64) self->header.nfiles * STAR_FHEADER_MIN_SIZE
+        && (!stream_size(in, &size) || hsize <= size);
+    if (!ok)
+        return NULL;
+
+    /* one more byte, a raw Stream can't be empty */
+    u8 * ret = NULL;
+    u64 cap = 0;
+    u64 done = 0;
+    do {
+        u64 n = min(hsize - done, (done > 0) ? done : (u64) 1 << 16);
+        ok =  _star_buf_reserve(&ret, &cap, done + n + 1)
+            && star_read_u8_single(ret + done, in, n);
+        done += n;
+    } while (ok && done < hsize);
+
+    if (!ok || _star_header_crc(self, self->header.version, ret) != self->header.hcrc) {
+        free(ret);
+        ret = NULL;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Find the sections of the headers of a STAR of version 9
+ * @param self The StarMap, with the STAR header
+ * @param hdata The headers after the STAR header, `self->header.hsize`
+ *     bytes, aligned to `STAR_MAP_ALIGN`
+ * @returns `true` if the sections are exactly as big as the headers,
+ *     `false` otherwise
+ */
+static bool _star_map_sections (struct StarMap * self, const u8 * hdata)
+{
+    u64 hsize = self->header.hsize;
+    if (hsize < sizeof(struct StarMapDir))
+        return false;
+
+    u64 nchunks = _star_map_get(hdata, struct StarMapDir, nchunks);
+    u64 ssize = _star_map_get(hdata, struct StarMapDir, ssize);
+
+    /* bounded first, so the sections can't overflow */
+    if (nchunks > hsize / sizeof(struct StarChunkRecord) || ssize > hsize)
+        return false;
+
+    struct _star_map_layout layout;
+    _star_map_place(&layout, &self->header, nchunks, ssize);
+    if (layout.size != hsize)
+        return false;
+
+    self->records = (const struct StarRecord *) (hdata + layout.records);
+    self->names   = (const u32 *) (hdata + layout.names);
+    self->chunks  = (const struct StarChunkRecord *) (hdata + layout.chunks);
+    self->nchunks = nchunks;
+    self->blocks  = (const struct StarBlockRecord *) (hdata + layout.blocks);
+    self->dict    = hdata + layout.dict;
+    self->strings = hdata + layout.strings;
+    self->ssize   = ssize;
+
+    return true;
+}
+
+/**
+ * @brief Get the solid block @a b of @a self
+ * @param self The StarMap
+ * @param b Index of the block
+ * @param block Where to put the block
+ * @returns `true` if the block's record checks out, `false` otherwise
+ */
+static bool _star_map_block (const struct StarMap * self, u64 b, struct StarBlock * block)
+{
+    if (b >= self->header.nblocks)
+        return false;
+
+    const struct StarBlockRecord * r = self->blocks + b;
+    struct StarBlock tmp = {
+        .offset = _star_map_get(r, struct StarBlockRecord, offset),
+        .size   = (u32) _star_map_get(r, struct StarBlockRecord, size),
+        .csize  = (u32) _star_map_get(r, struct StarBlockRecord, csize),
+        .codec  = (u8) _star_map_get(r, struct StarBlockRecord, codec),
+    };
+
+    /* data is never stored bigger than it is */
+    if (tmp.csize > tmp.size || tmp.codec > STAR_CODEC_LZ_DICT)
+        return false;
+
+    *block = tmp;
+    return true;
+}
+
+/**
+ * @brief Read the block table, dictionary and file headers of @a self
+ *     from @a hdata, laid out as in a STAR of version 9
+ * @param self The STAR, with the STAR header
+ * @param hdata The headers after the STAR header, `self->header.hsize`
+ *     bytes, aligned to `STAR_MAP_ALIGN`
+ * @returns `true` if every header checks out, `false` otherwise; what
+ *     was read is left in @a self either way, for `star_free()`
+ */
+static bool _star_map_read (struct STAR * self, const u8 * hdata)
+{
+    struct StarMap map = { .header = self->header };
+    u64 nblocks = self->header.nblocks;
+    u32 dsize = self->header.dsize;
+
+    bool ret = _star_map_sections(&map, hdata);
+
+    if (ret && nblocks > 0) {
+        self->blocks = calloc(nblocks, sizeof(struct StarBlock));
+        ret = self->blocks != NULL;
+        for (u64 i = 0; i < nblocks && ret; i++)
+            ret = _star_map_block(&map, i, self->blocks + i);
+    }
+
+    if (ret && dsize > 0) {
+        self->dict = malloc(dsize);
+        ret = self->dict != NULL;
+        if (ret)
+            memcpy(self->dict, map.dict, dsize);
+    }
+
+    if (ret) {
+        self->fheaders = calloc(self->header.nfiles, sizeof(struct StarFileHeader));
+        ret = self->fheaders != NULL;
+    }
+
+    for (u64 i = 0; i < self->header.nfiles && ret; i++)
+        ret = star_map_fheader(&map, i, self->fheaders + i);
+
+    return ret;
+}
+
+struct STAR * star_read_headers (Stream * in)
+{
+    struct STAR * ret = NULL;
+    struct STAR tmp = {0};
+    Stream hs = {0};
+    u8 * hdata = NULL;
+
+    /* failed to read header or `in` is not a STAR file */
+    ifjmp(!star_read_header(&tmp, in), out);
+
+    { /* allocate and copy the already read data */
+        ret = malloc(sizeof(struct STAR));
+        ifjmp(ret == NULL, out);
+        *ret = tmp;
+    }
+
+    /* since version 11, after the data, to be used in place */
+    ifjmp(ret->header.version > 10
+            && (ret->header.hoffset < _star_header_size(ret->header.version)
+                || ret->header.hoffset % STAR_MAP_ALIGN != 0
+                || !stream_seek(in, ret->header.hoffset)), ko);
+
+    /* the rest of the headers are read from memory, once checked */
+    Stream * hin = in;
+    if (ret->header.version > 5) {
+        hdata = _star_read_hdata(ret, in);
+        ifjmp(hdata == NULL, ko);
+        stream_from_raw(&hs, hdata, ret->header.hsize + 1);
+        hin = &hs;
+    }
+
+    /*
+     * if it wasnt possible to read everything, return NULL
+     */
+    if (ret->header.version > 8) {
+        /* laid out to be used in place; written back the same way */
+        ifjmp(!_star_map_read(ret, hdata), ko);
+        ret->mappable = true;
+        ret->appendable = ret->header.version > 10;
+
+        /* appended and compacted as it was laid out */
+        ret->align = ret->header.align;
+        ret->align_min = ret->header.align_min;
+    } else {
+        ifjmp(!star_read_blocks(ret, hin), ko);
+        ifjmp(!star_read_dict(ret, hin), ko);
+
+        /* number of successfully read file headers */
+        u64 nfheaders = star_read_fheaders(ret, hin);
+        ifjmp(ret->header.nfiles != nfheaders, ko);
+    }
+
+    /* the headers have to be exactly as big as they say */
+    ifjmp(ret->header.version > 5
+            && _star_hsize(ret, ret->header.version) != ret->header.hsize, ko);
+
+out:
+    stream_close(&hs);
+    return ret;
+
+ko: /* whatever wasn't read is zeroed */
+    star_free(ret);
+    ret = NULL;
+    goto out;
+}
+
+struct STAR * star_read (Stream * in)
+{
+    struct STAR * ret = star_read_headers(in);
+    ifjmp(ret == NULL, out);
+
+    /* number of successfully read files */
+    u64 nfdata = star_read_fdata(ret, in);
+    ifjmp(ret->header.nfiles != nfdata, ko);
+
+out:
+    return ret;
+
+ko:
+    star_free(ret);
+    ret = NULL;
+    goto out;
+}
+
+/**
+ * @brief Size of the pieces `star_extract()` copies data that isn't
+ *     compressed in, in bytes
+ */
+#define STAR_EXTRACT_BUF (1 << 20)
+
+/**
+ * @brief State of `star_extract()`
+ */
+struct _star_extract {
+    /** The STAR */
+    const struct STAR * star;
+    /** Where to read data from */
+    Stream * in;
+    /** Where to write data to */
+    Stream * out;
+    /** Scratch space for data as stored */
+    u8 * cbuf;
+    /** Size of `cbuf`, in bytes */
+    u64 cbufsize;
+    /** Scratch space for decoded data */
+    u8 * buf;
+    /** Size of `buf`, in bytes */
+    u64 bufsize;
+    /** CRC32C of the data written so far */
+    u32 crc;
+    /** How the data of a `STAR_F_SPARSE` file is laid out, as read so
+     *  far: its `struct StarSparse` and `struct StarRun`s */
+    u8 * sparse;
+    /** Size of `sparse` once it's all read, `0` if the file isn't
+     *  `STAR_F_SPARSE` */
+    u64 ssize;
+    /** Bytes of `sparse` read so far */
+    u64 sread;
+    /** Size of the file's data, as stored */
+    u64 dsize;
+    /** Index of the next run */
+    u64 run;
+    /** Bytes of the run being written left */
+    u64 left;
+    /** Where in the file it's writing */
+    u64 pos;
+    /** Whether `out` can seek past holes, or has to have them written */
+    bool seekable;
+};
+
+/**
+ * @brief Write zeros to `out` until @a to
+ * @param self State of `star_extract()`, of a `STAR_F_SPARSE` file
+ * @param to Where in the file to stop
+ * @returns `true` if the zeros were written, `false` otherwise
+ */
+static bool _star_sparse_zeros (struct _star_extract * self, u64 to)
+{
+    static const u8 zeros[1 << 12] = {0};
+
+    while (self->pos < to) {
+        u64 n = min(to - self->pos, (u64) sizeof(zeros));
+        if (stream_write(self->out, zeros, n, 1) != 1)
+            return false;
+        self->pos += n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Start a run of data of a `STAR_F_SPARSE` file, past the hole
+ *     before it: seeking in `out`, if it can, or writing zeros, if it
+ *     can't seek at all
+ * @param self State of `star_extract()`, with all of `sparse` read
+ * @returns `true` if the run was started, `false` if it isn't where it
+ *     should be, or an error occurred
+ */
+static bool _star_sparse_run (struct _star_extract * self)
+{
+    u64 size = _star_map_get(self->sparse, struct StarSparse, size);
+    u64 nruns = _star_map_get(self->sparse, struct StarSparse, nruns);
+    if (self->run >= nruns)
+        return false;
+
+    const u8 * r = self->sparse + sizeof(struct StarSparse) + self->run * sizeof(struct StarRun);
+    u64 offset = _star_map_get(r, struct StarRun, offset);
+    u64 rsize = _star_map_get(r, struct StarRun, size);
+
+    /* in order, and in the file */
+    if (offset < self->pos || rsize == 0 || offset > size || rsize > size - offset)
+        return false;
+
+    if (self->seekable) {
+        if (!stream_seek(self->out, offset))
+            return false;
+        self->pos = offset;
+    } else if (!_star_sparse_zeros(self, offset)) {
+        return false;
+    }
+
+    /* only the runs take room */
+    stream_reserve(self->out, rsize);
+
+    self->run++;
+    self->left = rsize;
+    return true;
+}
+
+/**
+ * @brief Write @a size bytes of the data of the file being extracted
+ *     to `out`, laid out with its holes if it's `STAR_F_SPARSE`, and
+ *     add them to `crc`
+ * @param self State of `star_extract()`
+ * @param data The data
+ * @param size Size of @a data, in bytes
+ * @returns `true` if the data was written, `false` otherwise
+ */
+static bool _star_extract_write (struct _star_extract * self, const u8 * data, u64 size)
+{
+    self->crc = crc32c(self->crc, data, size);
+
+    if (self->ssize == 0)
+        return size == 0 || stream_write(self->out, data, size, 1) == 1;
+
+    while (size > 0) {
+        u64 n = 0;
+
+        if (self->sread < self->ssize) {
+            /* how it's laid out, before any of its data */
+            n = min(size, self->ssize - self->sread);
+            memcpy(self->sparse + self->sread, data, n);
+            self->sread += n;
+
+            /* and how many runs it has, once that's read; the size has to fit in `off_t` */
+            if (self->sread == sizeof(struct StarSparse)) {
+                u64 nruns = _star_map_get(self->sparse, struct StarSparse, nruns);
+                if (nruns > (self->dsize - sizeof(struct StarSparse)) / sizeof(struct StarRun)
+                        || _star_map_get(self->sparse, struct StarSparse, size) > INT64_MAX)
+                    return false;
+
+                self->ssize += nruns * sizeof(struct StarRun);
+                u8 * tmp = realloc(self->sparse, self->ssize);
+                if (tmp == NULL)
+                    return false;
+                self->sparse = tmp;
+            }
+        } else {
+            if (self->left == 0 && !_star_sparse_run(self))
+                return false;
+
+            n = min(size, self->left);
+            if (stream_write(self->out, data, n, 1) != 1)
+                return false;
+            self->pos += n;
+            self->left -= n;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Start extracting a `STAR_F_SPARSE` file
+ * @param self State of `star_extract()`
+ * @param dsize Size of the file's data, as stored
+ * @returns `true` if it was started, `false` otherwise
+ */
+static bool _star_sparse_begin (struct _star_extract * self, u64 dsize)
+{
+    /* e.g., pipes */
+    u64 pos = 0;
+    self->seekable = stream_tell(self->out, &pos);
+
+    self->sparse = malloc(sizeof(struct StarSparse));
+    self->ssize = sizeof(struct StarSparse);
+    self->dsize = dsize;
+
+    return self->sparse != NULL
+        && dsize >= sizeof(struct StarSparse);
+}
+
+/**
+ * @brief Finish extracting a `STAR_F_SPARSE` file, with the hole at its
+ *     end, if any
+ * @param self State of `star_extract()`, with all of the file's data
+ *     written
+ * @returns `true` if the file was laid out as it says, `false` otherwise
+ */
+static bool _star_sparse_end (struct _star_extract * self)
+{
+    if (self->sread < self->ssize || self->left > 0)
+        return false;
+
+    u64 size = _star_map_get(self->sparse, struct StarSparse, size);
+    u64 nruns = _star_map_get(self->sparse, struct StarSparse, nruns);
+
+    return self->run == nruns
+        && (self->pos == size
+                || ((self->seekable) ?
+                    stream_truncate(self->out, size) :
+                    _star_sparse_zeros(self, size)));
+}
+
+/**
+ * @brief Copy @a size bytes at @a offset from `in` to `out`, decoding
+ *     them if needed, and add them to `crc`
+ * @param self State of `star_extract()`
+ * @param codec The codec the data is stored with
+ * @param offset Offset of the data
+ * @param csize Size of the data as stored, in bytes
+ * @param size Size of the data, in bytes
+ * @returns `true` if the data was copied, `false` otherwise
+ */
+static bool _star_extract_data (struct _star_extract * self, u8 codec, u64 offset, u64 csize, u64 size)
+{
+    if (!stream_seek(self->in, offset))
+        return false;
+
+    if (csize == size) {
+        if (!_star_buf_reserve(&self->buf, &self->bufsize, min(size, (u64) STAR_EXTRACT_BUF)))
+            return false;
+
+        for (u64 left = size; left > 0; ) {
+            u64 n = min(left, (u64) STAR_EXTRACT_BUF);
+            if (!star_read_u8_single(self->buf, self->in, n)
+                    || !_star_extract_write(self, self->buf, n))
+                return false;
+            left -= n;
+        }
+
+        return true;
+    }
+
+    if (!_star_buf_reserve(&self->cbuf, &self->cbufsize, csize)
+            || !_star_buf_reserve(&self->buf, &self->bufsize, size)
+            || !star_read_u8_single(self->cbuf, self->in, csize)
+            || !_star_decode(self->star, codec, self->cbuf, csize, self->buf, size))
+        return false;
+
+    return _star_extract_write(self, self->buf, size);
+}
+
+/**
+ * @brief Get the data of the solid block @a b of @a self, decoded
+ *     already, or read from `in`
+ * @param self The STAR
+ * @param ex State of `star_extract()`; only `in` and the buffers are used
+ * @param b Index of the block
+ * @returns The data of the block, or `NULL` if an error occurred
+ */
+static const u8 * _star_block_data (struct STAR * self, struct _star_extract * ex, u32 b)
+{
+    if (self->bcached == (u64) b + 1)
+        return self->bcache;
+
+    const struct StarBlock * blk = self->blocks + b;
+
+    self->bcached = 0;
+    if (!_star_buf_reserve(&ex->cbuf, &ex->cbufsize, blk->csize))
+        return NULL;
+
+    u8 * tmp = realloc(self->bcache, (size_t) blk->size + 1);
+    if (tmp == NULL)
+        return NULL;
+    self->bcache = tmp;
+
+    if (!stream_seek(ex->in, blk->offset)
+            || !star_read_u8_single(ex->cbuf, ex->in, blk->csize)
+            || !_star_decode(self, blk->codec, ex->cbuf, blk->csize, self->bcache, blk->size))
+        return NULL;
+
+    self->bcached = (u64) b + 1;
+    return self->bcache;
+}
+
+bool star_extract (struct STAR * self, u64 idx, Stream * in, Stream * out)
+{
+    bool ret = false;
+    struct _star_extract ex = { .star = self, .in = in, .out = out };
+
+    ifjmp(self == NULL, out);
+    ifjmp(self->fheaders == NULL, out);
+    ifjmp(in == NULL, out);
+    ifjmp(out == NULL, out);
+    ifjmp(idx >= self->header.nfiles, out);
+
+    const struct StarFileHeader * fh = self->fheaders + idx;
+
+    /* sparse files take room only for their runs, as they're written */
+    bool sparse = (fh->flags & STAR_F_SPARSE) != 0;
+    ifjmp(sparse && !_star_sparse_begin(&ex, fh->size), out);
+
+    /* if it can't be (e.g., to a pipe), it's written as usual */
+    if (!sparse)
+        stream_reserve(out, fh->size);
+
+    if (fh->flags & STAR_F_SOLID) {
+        const u8 * data = _star_block_data(self, &ex, fh->block);
+        ret =  data != NULL
+            && _star_extract_write(&ex, data + fh->offset, fh->size);
+    } else if (fh->flags & STAR_F_CHUNKED) {
+        ret = true;
+        for (u32 i = 0; i < fh->nchunks && ret; i++)
+            ret = _star_extract_data(&ex, fh->codec, fh->chunks[i].offset,
+                    fh->chunks[i].csize, fh->chunks[i].size);
+    } else {
+        ret = _star_extract_data(&ex, fh->codec, fh->offset, fh->csize, fh->size);
+    }
+
+    ret = ret && (ex.ssize == 0 || _star_sparse_end(&ex));
+
+    /* checked as it was written, not all over again */
+    ret = ret && (!(fh->flags & STAR_F_CHECKSUM) || ex.crc == fh->crc);
+
+out:
+    free(ex.sparse);
+    free(ex.cbuf);
+    free(ex.buf);
+    return ret;
+}
+
+bool star_prefetch (const struct STAR * self, u64 idx, Stream * in)
+{
+    if (self == NULL || self->fheaders == NULL || in == NULL || idx >= self->header.nfiles)
+        return false;
+
+    const struct StarFileHeader * fh = self->fheaders + idx;
+
+    if (fh->flags & STAR_F_SOLID) {
+        /* already decoded */
+        if (self->bcached == fh->block + 1)
+            return true;
+        const struct StarBlock * blk = self->blocks + fh->block;
+        return stream_willneed(in, blk->offset, blk->csize);
+    }
+
+    if (!(fh->flags & STAR_F_CHUNKED))
+        return stream_willneed(in, fh->offset, fh->csize);
+
+    /* chunks are mostly one after the other, told as few ranges as possible */
+    bool ret = true;
+    u64 from = 0;
+    u64 to = 0;
+    for (u32 i = 0; i < fh->nchunks; i++) {
+        const struct StarChunk * c = fh->chunks + i;
+        /* shared with the one before (see `star_chunk()`), already told */
+        if (c->offset >= from && c->offset + c->csize <= to)
+            continue;
+        if (c->offset != to) {
+            ret = stream_willneed(in, from, to - from) && ret;
+            from = c->offset;
+        }
+        to = c->offset + c->csize;
+    }
+
+    return stream_willneed(in, from, to - from) && ret;
+}
+
+/**
+ * @brief Find the chunk of @a fh with the byte at @a offset of its data
+ * @param fh The file header, `STAR_F_CHUNKED`
+ * @param offset Offset in the file's data, less than its size
+ * @returns Index of the chunk
+ */
+static u32 _star_chunk_find (const struct StarFileHeader * fh, u64 offset)
+{
+    /* last chunk starting at or before `offset` */
+    u32 lo = 0;
+    u32 hi = fh->nchunks;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (fh->chunks[mid].start <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo - 1;
+}
+
+/**
+ * @brief Read @a len bytes at @a from of some data to @a out, decoding
+ *     only as much as needed
+ * @param self State of `star_extract()`; only `in` and the buffers are used
+ * @param codec The codec the data is stored with
+ * @param offset Offset of the data
+ * @param csize Size of the data as stored, in bytes
+ * @param size Size of the data, in bytes
+ * @param from Offset in the data to read from
+ * @param len Number of bytes to read
+ * @param out Where to read to
+ * @param crc CRC32C all of the data has to match, `NULL` if none
+ * @returns `true` if the data was read, and matches @a crc, `false`
+ *     otherwise
+ */
+static bool _star_read_piece (struct _star_extract * self, u8 codec, u64 offset, u64 csize, u64 size, u64 from, u64 len, u8 * out, const u32 * crc)
+{
+    /* stored as is, read just what's needed */
+    if (csize == size && crc == NULL)
+        return stream_seek(self->in, offset + from)
+            && star_read_u8_single(out, self->in, len);
+
+    if (!stream_seek(self->in, offset)
+            || !_star_buf_reserve(&self->cbuf, &self->cbufsize, csize)
+            || !star_read_u8_single(self->cbuf, self->in, csize))
+        return false;
+
+    /* stored as is, but read whole, to be checked */
+    const u8 * data = self->cbuf;
+    if (csize != size) {
+        if (!_star_buf_reserve(&self->buf, &self->bufsize, size)
+                || !_star_decode(self->star, codec, self->cbuf, csize, self->buf, size))
+            return false;
+        data = self->buf;
+    }
+
+    if (crc != NULL && crc32c(0, data, size) != *crc)
+        return false;
+
+    memcpy(out, data + from, len);
+    return true;
+}
+
+bool star_read_range (struct STAR * self, u64 idx, u64 offset, u64 size, Stream * in, u8 * out)
+{
+    bool ret = false;
+    struct _star_extract ex = { .star = self, .in = in };
+
+    ifjmp(self == NULL, out);
+    ifjmp(self->fheaders == NULL, out);
+    ifjmp(in == NULL, out);
+    ifjmp(out == NULL && size > 0, out);
+    ifjmp(idx >= self->header.nfiles, out);
+
+    const struct StarFileHeader * fh = self->fheaders + idx;
+
+    ifjmp(offset > fh->size || size > fh->size - offset, out);
+
+    ret = true;
+    ifjmp(size == 0, out);
+
+    if (fh->flags & STAR_F_SOLID) {
+        const u8 * data = _star_block_data(self, &ex, fh->block);
+        ret = data != NULL;
+        if (ret)
+            memcpy(out, data + fh->offset + offset, size);
+        goto out;
+    }
+
+    if (!(fh->flags & STAR_F_CHUNKED)) {
+        ret = _star_read_piece(&ex, fh->codec, fh->offset, fh->csize,
+                fh->size, offset, size, out, NULL);
+        goto out;
+    }
+
+    /* only the chunks the range touches */
+    for (u32 i = _star_chunk_find(fh, offset); size > 0 && ret; i++) {
+        const struct StarChunk * c = fh->chunks + i;
+        u64 from = offset - c->start;
+        u64 len = min(size, c->size - from);
+
+        ret = _star_read_piece(&ex, fh->codec, c->offset, c->csize,
+                c->size, from, len, out,
+                (fh->flags & STAR_F_CHUNK_CHECKSUM) ? &c->crc : NULL);
+
+        offset += len;
+        size -= len;
+        out += len;
+    }
+
+out:
+    free(ex.cbuf);
+    free(ex.buf);
+    return ret;
+}
+
+/**
+ * @brief Where some data of a STAR is stored, for `star_verify()`
+ */
+struct _star_verify_extent {
+    /** Offset from the beggining of the STAR to the beggining of the data */
+    u64 offset;
+    /** Size of the data as stored, in bytes */
+    u64 csize;
+    /** Index of the file the data is of, or `nfiles` plus the index of
+     *  the solid block */
+    u64 owner;
+};
+
+static int _star_verify_extent_cmp (const void * _l, const void * _r)
+{
+    const struct _star_verify_extent * l = _l;
+    const struct _star_verify_extent * r = _r;
+
+#define cmp(f) if (l->f != r->f) return (l->f < r->f) ? -1 : 1
+    cmp(offset);
+    cmp(csize);
+    cmp(owner);
+#undef cmp
+
+    return 0;
+}
+
+/**
+ * @brief A chunk checked on its own by `star_verify()`, see
+ *     `STAR_F_CHUNK_CHECKSUM`
+ */
+struct _star_verify_chunk {
+    /** Index of the file the chunk is of */
+    u64 file;
+    /** The chunk */
+    const struct StarChunk * chunk;
+    /** Whether it doesn't check out */
+    bool bad;
+};
+
+/**
+ * @brief State of the threads checking files for `star_verify()`
+ */
+struct _star_verify {
+    /** The STAR */
+    const struct STAR * self;
+    /** Where to read data from, only with `stream_pread()` */
+    Stream * in;
+    /** For each file, whether it doesn't check out */
+    bool * bad;
+    /** Indices of the solid files, by block */
+    u64 * bfiles;
+    /** For each block, where its files start in `bfiles`, and then the end */
+    u64 * bstart;
+    /** The chunks checked on their own */
+    struct _star_verify_chunk * chunks;
+    /** Number of elements of `chunks` */
+    u64 nchunks;
+};
+
+/**
+ * @brief Read @a size bytes at @a offset, decoding them if needed, and
+ *     add them to `crc`
+ * @param self Scratch space and the CRC; `in` is read with
+ *     `stream_pread()`, and `out` isn't used
+ * @param codec The codec the data is stored with
+ * @param offset Offset of the data
+ * @param csize Size of the data as stored, in bytes
+ * @param size Size of the data, in bytes
+ * @param keep Keep all of the data in `buf`, not just the last piece
+ * @returns `true` if the data was read, `false` otherwise
+ */
+static bool _star_verify_data (struct _star_extract * self, u8 codec, u64 offset, u64 csize, u64 size, bool keep)
+{
+    if (csize == size && !keep) {
+        if (!_star_buf_reserve(&self->buf, &self->bufsize, min(size, (u64) STAR_EXTRACT_BUF)))
+            return false;
+
+        for (u64 off = 0; off < size; ) {
+            u64 n = min(size - off, (u64) STAR_EXTRACT_BUF);
+            if (stream_pread(self->in, self->buf, n, offset + off) != n)
+                return false;
+            self->crc = crc32c(self->crc, self->buf, n);
+            off += n;
+        }
+
+        return true;
+    }
+
+    if (!_star_buf_reserve(&self->cbuf, &self->cbufsize, csize)
+            || !_star_buf_reserve(&self->buf, &self->bufsize, size)
+            || stream_pread(self->in, self->cbuf, csize, offset) != csize
+            || !_star_decode(self->star, codec, self->cbuf, csize, self->buf, size))
+        return false;
+
+    self->crc = crc32c(self->crc, self->buf, size);
+    return true;
+}
+
+static void _star_verify_task (void * _ctx, size_t i)
+{
+    struct _star_verify * ctx = _ctx;
+    const struct STAR * self = ctx->self;
+    struct _star_extract ex = { .star = self, .in = ctx->in };
+
+    /* a solid block, and the files in it */
+    if (i < self->header.nblocks) {
+        const struct StarBlock * blk = self->blocks + i;
+        u64 from = ctx->bstart[i];
+        u64 to = ctx->bstart[i + 1];
+
+        bool ok = from == to
+            || (!ctx->bad[ctx->bfiles[from]]
+                    && _star_verify_data(&ex, blk->codec, blk->offset, blk->csize, blk->size, true));
+
+        for (u64 k = from; k < to; k++) {
+            const struct StarFileHeader * fh = self->fheaders + ctx->bfiles[k];
+            ctx->bad[ctx->bfiles[k]] = !ok
+                || ((fh->flags & STAR_F_CHECKSUM)
+                        && crc32c(0, ex.buf + fh->offset, fh->size) != fh->crc);
+        }
+
+        goto out;
+    }
+
+    i -= self->header.nblocks;
+
+    /* a chunk with its own checksum */
+    if (i < ctx->nchunks) {
+        struct _star_verify_chunk * vc = ctx->chunks + i;
+        const struct StarChunk * c = vc->chunk;
+
+        vc->bad = !ctx->bad[vc->file]
+            && (!_star_verify_data(&ex, self->fheaders[vc->file].codec,
+                        c->offset, c->csize, c->size, false)
+                    || ex.crc != c->crc);
+        goto out;
+    }
+
+    i -= ctx->nchunks;
+
+    /* solid files are checked with their block, and chunks on their own */
+    const struct StarFileHeader * fh = self->fheaders + i;
+    if (ctx->bad[i] || (fh->flags & (STAR_F_SOLID | STAR_F_CHUNK_CHECKSUM)))
+        goto out;
+
+    bool ok = true;
+    if (fh->flags & STAR_F_CHUNKED) {
+        for (u32 c = 0; c < fh->nchunks && ok; c++)
+            ok = _star_verify_data(&ex, fh->codec, fh->chunks[c].offset,
+                    fh->chunks[c].csize, fh->chunks[c].size, false);
+    } else {
+        ok = _star_verify_data(&ex, fh->codec, fh->offset, fh->csize, fh->size, false);
+    }
+
+    ctx->bad[i] = !ok || ((fh->flags & STAR_F_CHECKSUM) && ex.crc != fh->crc);
+
+out:
+    free(ex.cbuf);
+    free(ex.buf);
+}
+
+u64 star_verify (const struct STAR * self, Stream * in, u64 size, unsigned nthreads, bool * bad)
+{
+    u64 ret = STAR_DNF;
+    struct _star_verify ctx = { .self = self, .in = in, .bad = bad };
+    struct _star_verify_extent * ext = NULL;
+
+    ifjmp(self == NULL, out);
+    ifjmp(self->fheaders == NULL, out);
+    ifjmp(self->header.nblocks > 0 && self->blocks == NULL, out);
+    ifjmp(in == NULL, out);
+
+    u64 nfiles = self->header.nfiles;
+    u64 nblocks = self->header.nblocks;
+
+    if (ctx.bad == NULL)
+        ctx.bad = malloc(nfiles * sizeof(bool));
+    ifjmp(ctx.bad == NULL && nfiles > 0, out);
+    memset(ctx.bad, 0, nfiles * sizeof(bool));
+
+    /* where everything is stored */
+    u64 next = nblocks;
+    for (u64 i = 0; i < nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+
+        next += (fh->flags & STAR_F_CHUNKED) ?
+            fh->nchunks :
+            !(fh->flags & STAR_F_SOLID) ;
+
+        if (fh->flags & STAR_F_CHUNK_CHECKSUM)
+            ctx.nchunks += fh->nchunks;
+    }
+
+    ext = malloc(next * sizeof(struct _star_verify_extent));
+    ctx.bfiles = malloc(nfiles * sizeof(u64));
+    ctx.bstart = calloc(nblocks + 1, sizeof(u64));
+    ctx.chunks = malloc(ctx.nchunks * sizeof(struct _star_verify_chunk));
+    ifjmp((ext == NULL && next > 0) || (ctx.bfiles == NULL && nfiles > 0) || ctx.bstart == NULL
+            || (ctx.chunks == NULL && ctx.nchunks > 0), out);
+
+    /*
+     * the chunks' checksums have to make the file's, and then the
+     * chunks are checked on their own, on any thread
+     */
+    ctx.nchunks = 0;
+    for (u64 i = 0; i < nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+
+        if (!(fh->flags & STAR_F_CHUNK_CHECKSUM))
+            continue;
+
+        u32 crc = 0;
+        for (u32 c = 0; c < fh->nchunks; c++) {
+            crc = crc32c_combine(crc, fh->chunks[c].crc, fh->chunks[c].size);
+            ctx.chunks[ctx.nchunks++] = (struct _star_verify_chunk) {
+                .file = i,
+                .chunk = fh->chunks + c,
+            };
+        }
+
+        ctx.bad[i] = crc != fh->crc;
+    }
+
+    next = 0;
+    for (u64 b = 0; b < nblocks; b++)
+        ext[next++] = (struct _star_verify_extent) {
+            .offset = self->blocks[b].offset,
+            .csize = self->blocks[b].csize,
+            .owner = nfiles + b,
+        };
+
+    for (u64 i = 0; i < nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+
+        if (fh->flags & STAR_F_SOLID) {
+            ctx.bstart[fh->block + 1]++;
+        } else if (fh->flags & STAR_F_CHUNKED) {
+            for (u32 c = 0; c < fh->nchunks; c++)
+                ext[next++] = (struct _star_verify_extent) {
+                    .offset = fh->chunks[c].offset,
+                    .csize = fh->chunks[c].csize,
+                    .owner = i,
+                };
+        } else {
+            ext[next++] = (struct _star_verify_extent) {
+                .offset = fh->offset,
+                .csize = fh->csize,
+                .owner = i,
+            };
+        }
+    }
+
+    /* solid files, grouped by block */
+    for (u64 b = 0; b < nblocks; b++)
+        ctx.bstart[b + 1] += ctx.bstart[b];
+    for (u64 i = 0, * pos = ctx.bstart; i < nfiles; i++)
+        if (self->fheaders[i].flags & STAR_F_SOLID)
+            ctx.bfiles[pos[self->fheaders[i].block]++] = i;
+    for (u64 b = nblocks; b > 0; b--)
+        ctx.bstart[b] = ctx.bstart[b - 1];
+    ctx.bstart[0] = 0;
+
+    /*
+     * everything is between the headers and the end of the STAR, and
+     * doesn't overlap anything else, unless it's the same data, shared
+     */
+    qsort(ext, next, sizeof(struct _star_verify_extent), _star_verify_extent_cmp);
+
+    u64 begin = _star_fdata_offset(self, self->header.version);
+    const struct _star_verify_extent * far = NULL;
+
+    /* since version 11, the headers are after the data */
+    u64 hbegin = self->header.hoffset;
+    u64 hend = (self->header.version > 10) ? hbegin + self->header.hsize : hbegin;
+
+    for (u64 e = 0; e < next; e++) {
+        const struct _star_verify_extent * x = ext + e;
+        bool ok = x->csize == 0
+            || (x->offset >= begin && x->offset <= size && x->csize <= size - x->offset
+                    && (x->offset + x->csize <= hbegin || x->offset >= hend));
+
+        if (ok && x->csize > 0 && far != NULL && far->offset + far->csize > x->offset
+                && (far->offset != x->offset || far->csize != x->csize)) {
+            ok = false;
+            if (far->owner < nfiles)
+                ctx.bad[far->owner] = true;
+            else
+                for (u64 k = ctx.bstart[far->owner - nfiles]; k < ctx.bstart[far->owner - nfiles + 1]; k++)
+                    ctx.bad[ctx.bfiles[k]] = true;
+        }
+
+        if (!ok && x->owner < nfiles)
+            ctx.bad[x->owner] = true;
+        else if (!ok)
+            for (u64 k = ctx.bstart[x->owner - nfiles]; k < ctx.bstart[x->owner - nfiles + 1]; k++)
+                ctx.bad[ctx.bfiles[k]] = true;
+
+        if (ok && x->csize > 0 && (far == NULL || x->offset + x->csize > far->offset + far->csize))
+            far = x;
+    }
+
+    /* blocks first, they're the biggest */
+    par_for(nblocks + ctx.nchunks + nfiles, nthreads, _star_verify_task, &ctx);
+
+    for (u64 k = 0; k < ctx.nchunks; k++)
+        ctx.bad[ctx.chunks[k].file] |= ctx.chunks[k].bad;
+
+    ret = 0;
+    for (u64 i = 0; i < nfiles; i++)
+        ret += ctx.bad[i];
+
+out:
+    if (ctx.bad != bad)
+        free(ctx.bad);
+    free(ctx.bfiles);
+    free(ctx.bstart);
+    free(ctx.chunks);
+    free(ext);
+    return ret;
+}
+
+/***********************************************************
+ * map functions
+ **********************************************************/
+bool star_map (struct StarMap * self, const void * data, u64 size)
+{
+    bool ret = false;
+    struct STAR tmp = {0};
+    Stream in = {0};
+
+    ifjmp(self == NULL, out);
+    ifjmp(data == NULL, out);
+    ifjmp((uintptr_t) data % STAR_MAP_ALIGN != 0, out);
+
+    /* `in` is never closed, `data` isn't the Stream's to free */
+    ret =  size > 0
+        && size <= SIZE_MAX
+        && stream_from_raw(&in, (void *) data, (size_t) size)
+        && star_read_header(&tmp, &in)
+        && tmp.header.version > 8;
+    ifjmp(!ret, out);
+
+    u64 hoffset = tmp.header.hoffset;
+    struct StarMap map = {
+        .header = tmp.header,
+        .data = data,
+        .size = size,
+    };
+
+    ret =  hoffset >= _star_header_size(tmp.header.version)
+        && hoffset % STAR_MAP_ALIGN == 0
+        && hoffset <= size
+        && tmp.header.hsize <= size - hoffset
+        && _star_map_sections(&map, map.data + hoffset);
+
+    if (ret)
+        *self = map;
+
+out:
+    return ret;
+}
+
+/**
+ * @brief Get the index of the file @a i in order of path of @a self
+ * @param self The StarMap
+ * @param i Position of the file, in order of path
+ * @returns The index of the file
+ */
+static inline u64 _star_map_name (const struct StarMap * self, u64 i)
+{
+    return _star_map_uint((const u8 *) (self->names + i), sizeof(u32));
+}
+
+const u8 * star_map_path (const struct StarMap * self, u64 idx)
+{
+    if (self == NULL || idx >= self->header.nfiles)
+        return NULL;
+
+    const struct StarRecord * r = self->records + idx;
+    u64 path = _star_map_get(r, struct StarRecord, path);
+    u64 path_len = _star_map_get(r, struct StarRecord, path_len);
+
+    /* paths are `NULL` terminated */
+    return (path_len > 0
+            && path <= self->ssize
+            && path_len <= self->ssize - path
+            && self->strings[path + path_len - 1] == '\0') ?
+        self->strings + path :
+        NULL ;
+}
+
+u64 star_map_search (const struct StarMap * self, const u8 * fname)
+{
+    u64 ret = STAR_DNF;
+
+    ifjmp(self == NULL, out);
+    ifjmp(fname == NULL, out);
+
+    /* first file whose path isn't before `fname` */
+    u64 lo = 0;
+    u64 hi = self->header.nfiles;
+    while (lo < hi) {
+        u64 mid = lo + (hi - lo) / 2;
+        const u8 * path = star_map_path(self, _star_map_name(self, mid));
+        ifjmp(path == NULL, out);
+
+        if (star_strcmp(path, fname) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* the first of the files with that path that wasn't deleted */
+    for (; lo < self->header.nfiles; lo++) {
+        u64 idx = _star_map_name(self, lo);
+        const u8 * path = star_map_path(self, idx);
+        if (path == NULL || star_strcmp(path, fname) != 0)
+            break;
+
+        if (!(_star_map_get(self->records + idx, struct StarRecord, flags) & STAR_F_DELETED)) {
+            ret = idx;
+            break;
+        }
+    }
+
+out:
+    return ret;
+}
+
+bool star_map_fheader (const struct StarMap * self, u64 idx, struct StarFileHeader * fheader)
+{
+    bool ret = false;
+    struct StarFileHeader tmp = {0};
+
+    ifjmp(fheader == NULL, out);
+
+    const u8 * path = star_map_path(self, idx);
+    ifjmp(path == NULL, out);
+
+    const struct StarRecord * r = self->records + idx;
+    u64 chunk = _star_map_get(r, struct StarRecord, chunk);
+
+    tmp.size     = _star_map_get(r, struct StarRecord, size);
+    tmp.offset   = _star_map_get(r, struct StarRecord, offset);
+    tmp.csize    = _star_map_get(r, struct StarRecord, csize);
+    tmp.nchunks  = (u32) _star_map_get(r, struct StarRecord, nchunks);
+    tmp.block    = (u32) _star_map_get(r, struct StarRecord, block);
+    tmp.crc      = (u32) _star_map_get(r, struct StarRecord, crc);
+    tmp.path_len = (u16) _star_map_get(r, struct StarRecord, path_len);
+    tmp.flags    = (u8) _star_map_get(r, struct StarRecord, flags);
+    tmp.codec    = (u8) _star_map_get(r, struct StarRecord, codec);
+
+    bool chunked = (tmp.flags & STAR_F_CHUNKED) != 0;
+    bool solid = (tmp.flags & STAR_F_SOLID) != 0;
+    bool ccrc = (tmp.flags & STAR_F_CHUNK_CHECKSUM) != 0;
+    bool codec = tmp.codec != STAR_CODEC_NONE;
+
+    /*
+     * chunk checksums are only of chunks, and make the file's; sparse
+     * files are only since version 10, and deleted ones since 11; and
+     * data is never stored bigger than it is
+     */
+    ret =  tmp.codec <= STAR_CODEC_LZ_DICT
+        && (!ccrc || (chunked && (tmp.flags & STAR_F_CHECKSUM)))
+        && (!(tmp.flags & STAR_F_SPARSE) || self->header.version > 9)
+        && (!(tmp.flags & STAR_F_DELETED) || self->header.version > 10)
+        && !(chunked && solid)
+        && tmp.csize <= tmp.size;
+    ifjmp(!ret, out);
+
+    /* only data stored on its own, and not in chunks, has a stored size */
+    if (!codec || chunked || solid)
+        tmp.csize = tmp.size;
+
+    /* solid files have to be in their block */
+    if (solid) {
+        struct StarBlock block = {0};
+        ret =  _star_map_block(self, tmp.block, &block)
+            && tmp.offset <= block.size
+            && tmp.size <= block.size - tmp.offset;
+        ifjmp(!ret, out);
+    }
+
+    if (chunked) {
+        /* chunks are never empty */
+        ret =  tmp.nchunks <= tmp.size
+            && chunk <= self->nchunks
+            && tmp.nchunks <= self->nchunks - chunk;
+        ifjmp(!ret, out);
+
+        tmp.chunks = calloc(tmp.nchunks, sizeof(struct StarChunk));
+        ret = tmp.nchunks == 0 || tmp.chunks != NULL;
+
+        u64 size = 0;
+        for (u32 i = 0; i < tmp.nchunks && ret; i++) {
+            const struct StarChunkRecord * cr = self->chunks + chunk + i;
+            struct StarChunk * c = tmp.chunks + i;
+
+            c->offset = _star_map_get(cr, struct StarChunkRecord, offset);
+            c->size   = (u32) _star_map_get(cr, struct StarChunkRecord, size);
+            c->csize  = (codec) ?
+                (u32) _star_map_get(cr, struct StarChunkRecord, csize) :
+                c->size ;
+            c->crc    = (ccrc) ?
+                (u32) _star_map_get(cr, struct StarChunkRecord, crc) :
+                0 ;
+            ret = c->csize <= c->size;
+
+            c->start = size;
+            size += c->size;
+        }
+
+        ret = ret && size == tmp.size;
+        ifjmp(!ret, ko);
+    } else {
+        tmp.nchunks = 0;
+    }
+
+    if (!solid)
+        tmp.block = 0;
+    if (!(tmp.flags & STAR_F_CHECKSUM))
+        tmp.crc = 0;
+
+    tmp.path = malloc(tmp.path_len);
+    ifjmp(tmp.path == NULL, ko);
+    memcpy(tmp.path, path, tmp.path_len);
+
+    *fheader = tmp;
+
+out:
+    return ret;
+
+ko:
+    free(tmp.chunks);
+    ret = false;
+    goto out;
+}
+
+bool star_map_extract (const struct StarMap * self, u64 idx, Stream * out)
+{
+    bool ret = false;
+    struct StarFileHeader fh = {0};
+    struct StarBlock block = {0};
+    Stream in = {0};
+
+    ifjmp(self == NULL, out);
+    ifjmp(self->data == NULL, out);
+    ifjmp(out == NULL, out);
+    ifjmp(!star_map_fheader(self, idx, &fh), out);
+
+    /* a STAR of only this file, with only its block */
+    struct STAR tmp = {
+        .header = self->header,
+        .fheaders = &fh,
+        .dict = (u8 *) self->dict,
+    };
+    tmp.header.nfiles = 1;
+
+    /* whatever is stored has to be in the STAR, not checked up front */
+    if (fh.flags & STAR_F_SOLID) {
+        ret =  _star_map_block(self, fh.block, &block)
+            && block.offset <= self->size
+            && block.csize <= self->size - block.offset;
+        fh.block = 0;
+        tmp.blocks = &block;
+        tmp.header.nblocks = 1;
+    } else if (fh.flags & STAR_F_CHUNKED) {
+        ret = true;
+        for (u32 i = 0; i < fh.nchunks && ret; i++)
+            ret =  fh.chunks[i].offset <= self->size
+                && fh.chunks[i].csize <= self->size - fh.chunks[i].offset;
+    } else {
+        ret =  fh.offset <= self->size
+            && fh.csize <= self->size - fh.offset;
+    }
+
+    /* `in` is never closed, `self->data` isn't the Stream's to free */
+    ret =  ret
+        && stream_from_raw(&in, (void *) self->data, (size_t) self->size)
+        && star_extract(&tmp, 0, &in, out);
+
+    free(tmp.bcache);
+    free(fh.path);
+    free(fh.chunks);
+
+out:
+    return ret;
+}
+
+/***********************************************************
+ * write functions (assume `out` was opened in write mode)
+ **********************************************************/
+
+/*
+ * macro to define functions to write specific unsigned integer types
+ */
+#define _star_make_write_fun(name, type)                       \
+    bool name (const type * in, Stream * out, u64 nmemb) {     \
+        ifjmp(in == NULL, ko);                                 \
+        ifjmp(out == NULL, ko);                                \
+        u8 buf[sizeof(type)] = {0};                            \
+        for (u64 i = 0; i < nmemb; i++) {                      \
+            _star_uint_width_encode(buf, in[i], sizeof(type)); \
+            u64 w = stream_write(out, buf, sizeof(type), 1);   \
+            ifjmp(w != 1, ko);                                 \
+        }                                                      \
+        return true;                                           \
+    ko:                                                        \
+        return false;                                          \
+    } bool name (const type * in, Stream * out, u64 nmemb)
+
+/*
+ * define functions to write specific unsigned integer types
+ */
+_star_make_write_fun(star_write_u8, u8);
+_star_make_write_fun(star_write_u32, u32);
+_star_make_write_fun(star_write_u64, u64);
+
+/**
+ * @brief Write @a in with @a width to @a out, for fields whose width
+ *     depends on the version
+ * @param in The integer to write, that has to fit in @a width
+ * @param width The width of the integer, in bytes
+ * @param out The Stream
+ * @returns `true` if it was written, `false` otherwise
+ */
+static bool _star_write_uint (u64 in, size_t width, Stream * out)
+{
+    u8 buf[sizeof(u64)] = {0};
+
+    if (width > sizeof(u64))
+        return false;
+
+    _star_uint_width_encode(buf, in, width);
+    return stream_write(out, buf, width, 1) == 1;
+}
+
+#define star_write_u8_single(IN, OUT, SIZE) \
+        ((SIZE) == 0 || stream_write((OUT), (IN), (SIZE), 1) == 1)
+
+bool star_write_header (const struct STAR * self, u8 version, Stream * out)
+{
+    if (self == NULL || out == NULL)
+        return false;
+
+    static const u32 versioned = 0;
+    static const u8 pad[STAR_MAP_HEADER_PAD] = {0};
+
+    return star_write_u8_single(STAR_MAGIC, out, sizeof(STAR_MAGIC))
+        && (version < 2
+                || (star_write_u32(&versioned, out, 1)
+                    && star_write_u8(&version, out, 1)))
+        && star_write_u32(&self->header.nfiles, out, 1)
+        && (version < 3 || star_write_u32(&self->header.nblocks, out, 1))
+        && (version < 4 || star_write_u32(&self->header.dsize, out, 1))
+        && (version < 9 || star_write_u8_single(pad, out, sizeof(pad)))
+        && (version < 11
+                || (star_write_u64(&self->header.hoffset,   out, 1)
+                    && star_write_u64(&self->header.align,     out, 1)
+                    && star_write_u64(&self->header.align_min, out, 1)))
+        && (version < 6
+                || (star_write_u64(&self->header.hsize, out, 1)
+                    && star_write_u32(&self->header.hcrc, out, 1)));
+}
+
+bool star_write_blocks (const struct STAR * self, Stream * out)
+{
+    if (self == NULL || out == NULL)
+        return false;
+
+    bool ret = true;
+    for (u64 i = 0; i < self->header.nblocks && ret; i++) {
+        const struct StarBlock * b = self->blocks + i;
+        ret =  star_write_u64(&b->offset, out, 1)
+            && star_write_u32(&b->size,   out, 1)
+            && star_write_u32(&b->csize,  out, 1)
+            && star_write_u8(&b->codec,   out, 1);
+    }
+    return ret;
+}
+
+bool star_write_dict (const struct STAR * self, Stream * out)
+{
+    return self != NULL
+        && out != NULL
+        && star_write_u8_single(self->dict, out, self->header.dsize);
+}
+
+bool star_write_fheader (const struct StarFileHeader * fh, u8 version, Stream * out)
+{
+    if (fh == NULL || out == NULL)
+        return false;
+
+    bool ret = _star_write_uint(fh->size,     STAR_SIZE_WIDTH(version), out)
+        && star_write_u64(&fh->offset,        out, 1)
+        && _star_write_uint(fh->path_len,     STAR_PATH_LEN_WIDTH(version), out)
+        && star_write_u8_single(fh->path,     out, fh->path_len)
+        && (version < 2
+                || (star_write_u8(&fh->flags, out, 1)
+                    && star_write_u8(&fh->codec, out, 1)));
+
+    bool codec = fh->codec != STAR_CODEC_NONE;
+
+    if (ret && (fh->flags & STAR_F_CHECKSUM))
+        ret = star_write_u32(&fh->crc, out, 1);
+
+    if (ret && (fh->flags & STAR_F_SOLID))
+        ret = star_write_u32(&fh->block, out, 1);
+    else if (ret && codec && !(fh->flags & STAR_F_CHUNKED))
+        ret = _star_write_uint(fh->csize, STAR_SIZE_WIDTH(version), out);
+
+    if (ret && (fh->flags & STAR_F_CHUNKED)) {
+        ret = star_write_u32(&fh->nchunks, out, 1);
+        for (u32 i = 0; i < fh->nchunks && ret; i++)
+            ret =  star_write_u64(&fh->chunks[i].offset, out, 1)
+                && star_write_u32(&fh->chunks[i].size,   out, 1)
+                && (!codec || star_write_u32(&fh->chunks[i].csize, out, 1))
+                && (!(fh->flags & STAR_F_CHUNK_CHECKSUM)
+                        || star_write_u32(&fh->chunks[i].crc, out, 1));
+    }
+
+    return ret;
+}
+
+bool star_write_fheaders (const struct STAR * self, u8 version, Stream * out)
+{
+    if (self == NULL || out == NULL)
+        return false;
+
+    bool ret = true;
+    for (u64 i = 0; i < self->header.nfiles && ret; i++)
+        ret = star_write_fheader(self->fheaders + i, version, out);
+    return ret;
+}
+
+/**
+ * @brief Write zeros to @a out, from @a pos up to @a offset, where the
+ *     next data goes
+ * @param out The Stream
+ * @param pos Where @a out is, moved to @a offset
+ * @param offset Where the next data goes
+ * @returns `true` if @a out got to @a offset, `false` if it was already
+ *     past it or an error occurred
+ */
+static bool _star_write_pad (Stream * out, u64 * pos, u64 offset)
+{
+    static const u8 zeros[1 << 12] = {0};
+
+    if (offset < *pos)
+        return false;
+
+    while (*pos < offset) {
+        u64 n = min(offset - *pos, (u64) sizeof(zeros));
+        if (!star_write_u8_single(zeros, out, n))
+            return false;
+        *pos += n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write the data of the files @a first and after of @a self to
+ *     @a out, where `star_file_offsets()` put it, maybe padded
+ * @param self The STAR
+ * @param first Index of the first file to write
+ * @param pos Where @a out is, moved to the end of the data
+ * @param out The Stream
+ * @returns `true` if the data was written, `false` otherwise
+ */
+static bool _star_write_fdata (const struct STAR * self, u64 first, u64 * pos, Stream * out)
+{
+    bool ret = true;
+    u32 nblocks = 0;
+    for (u64 i = first; i < self->header.nfiles && ret; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+
+        /* blocks go where their first file would */
+        if (fh->flags & STAR_F_SOLID) {
+            if (fh->block == nblocks) {
+                const struct StarBlock * b = self->blocks + nblocks;
+                ret =  _star_write_pad(out, pos, b->offset)
+                    && star_write_u8_single(self->bdata[nblocks], out, b->csize);
+                *pos += b->csize;
+                nblocks++;
+            }
+            continue;
+        }
+
+        /* stored data has only the chunks with their own data */
+        const u8 * data = (self->cdata != NULL && self->cdata[i] != NULL) ?
+            self->cdata[i] :
+            self->fdata[i] ;
+        bool stored = data != self->fdata[i];
+
+        if (fh->flags & STAR_F_CHUNKED) {
+            /* only the chunks with their own data */
+            u64 off = 0;
+            for (u32 c = 0; c < fh->nchunks && ret; c++) {
+                const struct StarChunk * chunk = fh->chunks + c;
+
+                if (chunk->same == NULL) {
+                    ret =  _star_write_pad(out, pos, chunk->offset)
+                        && star_write_u8_single(data + off, out, chunk->csize);
+                    off += chunk->csize;
+                    *pos += chunk->csize;
+                } else if (!stored) {
+                    off += chunk->size;
+                }
+            }
+        } else if (self->same == NULL || self->same[i] == i) {
+            ret =  _star_write_pad(out, pos, fh->offset)
+                && star_write_u8_single(data, out, fh->csize);
+            *pos += fh->csize;
+        }
+    }
+    return ret;
+}
+
+bool star_write_fdata (const struct STAR * self, Stream * out)
+{
+    if (self == NULL || out == NULL || self->fheaders == NULL || self->fdata == NULL)
+        return false;
+
+    u64 pos = _star_fdata_offset(self, _star_version(self));
+    return _star_write_fdata(self, 0, &pos, out);
+}
+
+/**
+ * @brief A path, with the index of its file
+ */
+struct _star_map_name {
+    /** The path */
+    const u8 * path;
+    /** Index of the file */
+    u32 idx;
+};
+
+static int _star_map_name_cmp (const void * _l, const void * _r)
+{
+    const struct _star_map_name * l = _l;
+    const struct _star_map_name * r = _r;
+
+    /* files with the same path in the order they were archived */
+    int cmp = star_strcmp(l->path, r->path);
+    return (cmp != 0) ?
+        cmp :
+        (l->idx > r->idx) - (l->idx < r->idx) ;
+}
+
+/**
+ * @brief Lay out the block table, dictionary and file headers of @a self
+ *     in @a hdata, as in a STAR of version 9
+ * @param self The STAR
+ * @param hdata Where to lay them out, zeroed, as big as they are
+ * @returns `true` if they were laid out, `false` otherwise
+ */
+static bool _star_map_write (const struct STAR * self, u8 * hdata)
+{
+    u64 nfiles = self->header.nfiles;
+    struct _star_map_name * names = malloc(nfiles * sizeof(struct _star_map_name));
+    if (names == NULL)
+        return false;
+
+    struct _star_map_layout layout;
+    u64 nchunks = 0;
+    u64 ssize = 0;
+    _star_map_layout_of(self, &layout, &nchunks, &ssize);
+
+    _star_map_set(hdata, struct StarMapDir, nchunks, nchunks);
+    _star_map_set(hdata, struct StarMapDir, ssize,   ssize);
+
+    /* chunks and paths are in the order of their files */
+    u64 chunk = 0;
+    u64 path = 0;
+    for (u64 i = 0; i < nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+        u8 * r = hdata + layout.records + i * sizeof(struct StarRecord);
+
+        bool chunked = (fh->flags & STAR_F_CHUNKED) != 0;
+        bool solid = (fh->flags & STAR_F_SOLID) != 0;
+        bool ccrc = (fh->flags & STAR_F_CHUNK_CHECKSUM) != 0;
+        bool codec = fh->codec != STAR_CODEC_NONE;
+        u32 fchunks = (chunked) ? fh->nchunks : 0;
+
+        _star_map_set(r, struct StarRecord, size,     fh->size);
+        _star_map_set(r, struct StarRecord, offset,   fh->offset);
+        _star_map_set(r, struct StarRecord, csize,    (codec && !chunked && !solid) ? fh->csize : fh->size);
+        _star_map_set(r, struct StarRecord, chunk,    (chunked) ? chunk : 0);
+        _star_map_set(r, struct StarRecord, path,     path);
+        _star_map_set(r, struct StarRecord, nchunks,  fchunks);
+        _star_map_set(r, struct StarRecord, block,    (solid) ? fh->block : 0);
+        _star_map_set(r, struct StarRecord, crc,      (fh->flags & STAR_F_CHECKSUM) ? fh->crc : 0);
+        _star_map_set(r, struct StarRecord, path_len, fh->path_len);
+        _star_map_set(r, struct StarRecord, flags,    fh->flags);
+        _star_map_set(r, struct StarRecord, codec,    fh->codec);
+
+        for (u32 c = 0; c < fchunks; c++) {
+            const struct StarChunk * fc = fh->chunks + c;
+            u8 * cr = hdata + layout.chunks + (chunk + c) * sizeof(struct StarChunkRecord);
+
+            _star_map_set(cr, struct StarChunkRecord, offset, fc->offset);
+            _star_map_set(cr, struct StarChunkRecord, size,   fc->size);
+            _star_map_set(cr, struct StarChunkRecord, csize,  (codec) ? fc->csize : fc->size);
+            _star_map_set(cr, struct StarChunkRecord, crc,    (ccrc) ? fc->crc : 0);
+        }
+
+        memcpy(hdata + layout.strings + path, fh->path, fh->path_len);
+
+        chunk += fchunks;
+        path += fh->path_len;
+        names[i] = (struct _star_map_name) { .path = fh->path, .idx = (u32) i };
+    }
+
+    qsort(names, nfiles, sizeof(struct _star_map_name), _star_map_name_cmp);
+    for (u64 i = 0; i < nfiles; i++)
+        _star_uint_width_encode(hdata + layout.names + i * sizeof(u32), names[i].idx, sizeof(u32));
+
+    for (u64 i = 0; i < self->header.nblocks; i++) {
+        const struct StarBlock * b = self->blocks + i;
+        u8 * br = hdata + layout.blocks + i * sizeof(struct StarBlockRecord);
+
+        _star_map_set(br, struct StarBlockRecord, offset, b->offset);
+        _star_map_set(br, struct StarBlockRecord, size,   b->size);
+        _star_map_set(br, struct StarBlockRecord, csize,  b->csize);
+        _star_map_set(br, struct StarBlockRecord, codec,  b->codec);
+    }
+
+    if (self->header.dsize > 0)
+        memcpy(hdata + layout.dict, self->dict, self->header.dsize);
+
+    free(names);
+    return true;
+}
+
+/**
+ * @brief A piece of stored data `star_compact()` copies
+ */
+struct _star_range {
+    /** Offset of the data in the STAR it's copied from */
+    u64 from;
+    /** Offset of the data in the STAR it's copied to */
+    u64 to;
+    /** Size of the data, as stored, in bytes */
+    u64 csize;
+    /** Size of the file or block, to align the data by (see
+     *  `_star_align()`); `0` if it isn't */
+    u64 size;
+};
+
+/**
+ * @brief The stored data `star_compact()` copies, and where from
+ */
+struct _star_copy {
+    /** The Stream with the STAR it's copied from */
+    Stream * in;
+    /** The pieces of data, in order */
+    struct _star_range * ranges;
+    /** Number of pieces */
+    u64 n;
+};
+
+/**
+ * @brief Write the data of the files of @a self to @a out, from memory,
+ *     or copied from @a copy
+ * @param self The STAR
+ * @param copy What to copy, or `NULL` to write from memory
+ * @param pos Where @a out is, moved to the end of the data
+ * @param out The Stream
+ * @returns `true` if the data was written, `false` otherwise
+ */
+static bool _star_write_data (const struct STAR * self, const struct _star_copy * copy, u64 * pos, Stream * out)
+{
+    if (copy == NULL)
+        return _star_write_fdata(self, 0, pos, out);
+
+    bool ret = true;
+    for (u64 i = 0; i < copy->n && ret; i++) {
+        const struct _star_range * r = copy->ranges + i;
+        ret =  _star_write_pad(out, pos, r->to)
+            && stream_copy(out, copy->in, r->csize, r->from) == r->csize;
+        *pos += r->csize;
+    }
+    return ret;
+}
+
+/**
+ * @brief Write @a self to @a out, as `star_write()`, with the files'
+ *     data from memory, or copied from @a copy
+ * @param self The STAR
+ * @param copy What to copy, or `NULL` to write from memory
+ * @param out The Stream
+ * @returns `true` if @a self was written, `false` otherwise
+ */
+static bool _star_write (const struct STAR * self, const struct _star_copy * copy, Stream * out)
+{
+    if (out == NULL || !star_check_header(self)
+            || (copy == NULL && !_star_check_ptrs(self)))
+        return false;
+
+    u8 version = _star_version(self);
+    u64 pos = _star_fdata_offset(self, version);
+
+    if (version < 6)
+        return star_write_header(self,   version, out)
+            && star_write_blocks(self,   out)
+            && star_write_dict(self,     out)
+            && star_write_fheaders(self, version, out)
+            && _star_write_data(self,    copy, &pos, out);
+
+    /* the header has the size and checksum of what comes after it */
+    struct STAR tmp = *self;
+    tmp.header.hsize = _star_hsize(self, version);
+
+    /* one more byte, a raw Stream can't be empty */
+    bool ret = false;
+    Stream hs = {0};
+    u8 * hdata = calloc(tmp.header.hsize + 1, sizeof(u8));
+    ifjmp(hdata == NULL, out);
+
+    ret = (version > 8) ?
+        _star_map_write(self, hdata) :
+        stream_from_raw(&hs, hdata, tmp.header.hsize + 1)
+            && star_write_blocks(self,   &hs)
+            && star_write_dict(self,     &hs)
+            && star_write_fheaders(self, version, &hs);
+
+    if (ret) {
+        tmp.header.hcrc = _star_header_crc(&tmp, version, hdata);
+        ret = star_write_header(&tmp, version, out);
+    }
+
+    /* since version 11, the data comes first, and the headers after it */
+    if (ret && version > 10)
+        ret =  _star_write_data(self, copy, &pos, out)
+            && _star_write_pad(out, &pos, self->header.hoffset)
+            && star_write_u8_single(hdata, out, tmp.header.hsize);
+    else if (ret)
+        ret =  star_write_u8_single(hdata, out, tmp.header.hsize)
+            && _star_write_data(self, copy, &pos, out);
+
+    free(hdata);
+out:
+    return ret;
+}
+
+bool star_write (const struct STAR * self, Stream * out)
+{
+    return _star_write(self, NULL, out);
+}
+
+/***********************************************************
+ * create functions
+ **********************************************************/
+struct STAR * star_new (u32 nfiles)
+{
+    struct STAR * ret = NULL;
+    struct STAR tmp = {0};
+
+    ifjmp(nfiles == 0, out);
+
+    bool res = ((tmp.fdata = calloc(nfiles, sizeof(u8 *))) != NULL)
+        && ((tmp.fheaders = calloc(nfiles, sizeof(struct StarFileHeader))) != NULL)
+        && ((ret = malloc(sizeof(struct STAR))) != NULL);
+
+    ifjmp(!res, ko);
+
+    memcpy(&tmp.header.magic, STAR_MAGIC, sizeof(STAR_MAGIC));
+    tmp.header.nfiles = nfiles;
+
+    *ret = tmp;
+
+out:
+    return ret;
+
+ko:
+    if (ret != NULL) {
+        free(ret);
+        ret = NULL;
+    }
+
+    if (tmp.fdata != NULL)
+        free(tmp.fdata);
+
+    if (tmp.fheaders != NULL)
+        free(tmp.fheaders);
+
+    goto out;
+}
+
+bool star_extend (struct STAR * self, u32 n)
+{
+    if (self == NULL || self->fheaders == NULL || (u64) self->header.nfiles + n > UINT32_MAX)
+        return false;
+
+    u32 nfiles = self->header.nfiles;
+    u32 total = nfiles + n;
+
+    struct StarFileHeader * fheaders = realloc(self->fheaders, total * sizeof(struct StarFileHeader));
+    if (fheaders == NULL)
+        return false;
+    self->fheaders = fheaders;
+    memset(fheaders + nfiles, 0, n * sizeof(struct StarFileHeader));
+
+    /* a STAR that was read has no data, but the added files will */
+    u8 ** fdata = realloc(self->fdata, total * sizeof(u8 *));
+    if (fdata == NULL)
+        return false;
+    if (self->fdata == NULL)
+        memset(fdata, 0, nfiles * sizeof(u8 *));
+    self->fdata = fdata;
+    memset(fdata + nfiles, 0, n * sizeof(u8 *));
+
+    if (self->same != NULL) {
+        u32 * same = realloc(self->same, total * sizeof(u32));
+        if (same == NULL)
+            return false;
+        self->same = same;
+        for (u32 i = nfiles; i < total; i++)
+            same[i] = i;
+    }
+
+    if (self->cdata != NULL) {
+        u8 ** cdata = realloc(self->cdata, total * sizeof(u8 *));
+        if (cdata == NULL)
+            return false;
+        self->cdata = cdata;
+        memset(cdata + nfiles, 0, n * sizeof(u8 *));
+    }
+
+    self->header.nfiles = total;
+    return true;
+}
+
+/**
+ * @brief Add a file, whose data was already read, to @a self
+ * @param self The STAR
+ * @param idx Index where to add the file
+ * @param path The filename of the file
+ * @param fdata The file's data, @a self's to `free()` if it's added
+ * @param size Size of @a fdata, in bytes
+ * @param flags Flags of the file, besides `STAR_F_CHECKSUM`
+ * @returns `true` if the file was added, `false` if an error occurred,
+ *     or @a path is too long for `path_len`
+ */
+static bool _star_add (struct STAR * self, u32 idx, const u8 * path, u8 * fdata, u64 size, u8 flags)
+{
+    struct StarFileHeader fheader = {0};
+
+    /* the path's length, with the `NULL` byte, has to fit in `path_len` */
+    size_t path_len = strlen((void *) path) + 1;
+    if (path_len > UINT16_MAX)
+        return false;
+
+    fheader.path = (void *) strdup((void *) path);
+    if (fheader.path == NULL)
+        return false;
+    fheader.path_len = (u16) path_len;
+
+    fheader.size = size;
+    fheader.csize = size;
+    fheader.crc = crc32c(0, fdata, size);
+    fheader.flags = STAR_F_CHECKSUM | flags;
+
+    self->fdata[idx] = fdata;
+    self->fheaders[idx] = fheader;
+
+    return true;
+}
+
+bool star_add_file (struct STAR * self, u32 idx, const u8 * path, u64 size, Stream * in)
+{
+    bool ret = false;
+    u8 * fdata = NULL;
+
+    ifjmp(self == NULL, out);
+    ifjmp(in == NULL, out);
+    ifjmp(path == NULL, out);
+    ifjmp(idx >= self->header.nfiles, out);
+
+    fdata = malloc(size);
+    ifjmp(fdata == NULL, out);
+
+    ret =  star_read_u8_single(fdata, in, size)
+        && _star_add(self, idx, path, fdata, size, 0);
+
+    if (!ret)
+        free(fdata);
+
+out:
+    return ret;
+}
+
+bool star_add_sparse (struct STAR * self, u32 idx, const u8 * path, u64 size, Stream * in)
+{
+    bool ret = false;
+    u8 * fdata = NULL;
+    struct StarRun * runs = NULL;
+    u64 nruns = 0;
+    u64 cap = 0;
+    u64 dsize = 0;
+
+    ifjmp(self == NULL, out);
+    ifjmp(in == NULL, out);
+    ifjmp(path == NULL, out);
+    ifjmp(idx >= self->header.nfiles, out);
+
+    /* the runs of data, up to `size`; where it can't tell, there are no holes */
+    bool known = true;
+    for (u64 offset = 0; offset < size; ) {
+        u64 data = 0;
+        u64 hole = 0;
+        known = stream_data(in, offset, &data, &hole);
+        if (!known || data >= size)
+            break;
+
+        if (nruns == cap) {
+            cap = (cap > 0) ? 2 * cap : 16;
+            struct StarRun * tmp = realloc(runs, cap * sizeof(struct StarRun));
+            ifjmp(tmp == NULL, out);
+            runs = tmp;
+        }
+
+        hole = min(hole, size);
+        runs[nruns++] = (struct StarRun) { .offset = data, .size = hole - data };
+        dsize += hole - data;
+        offset = hole;
+    }
+
+    u64 isize = sizeof(struct StarSparse) + nruns * sizeof(struct StarRun) + dsize;
+
+    /* no holes worth the runs */
+    if (!known || isize >= size) {
+        ret =  stream_seek(in, 0)
+            && star_add_file(self, idx, path, size, in);
+        goto out;
+    }
+
+    fdata = malloc(isize);
+    ifjmp(fdata == NULL, out);
+
+    u8 * p = fdata;
+    _star_map_set(p, struct StarSparse, size, size);
+    _star_map_set(p, struct StarSparse, nruns, nruns);
+    p += sizeof(struct StarSparse);
+
+    for (u64 r = 0; r < nruns; r++, p += sizeof(struct StarRun)) {
+        _star_map_set(p, struct StarRun, offset, runs[r].offset);
+        _star_map_set(p, struct StarRun, size, runs[r].size);
+    }
+
+    for (u64 r = 0; r < nruns; r++) {
+        ifjmp(!stream_seek(in, runs[r].offset)
+                || !star_read_u8_single(p, in, runs[r].size), out);
+        p += runs[r].size;
+    }
+
+    ret = _star_add(self, idx, path, fdata, isize, STAR_F_SPARSE);
+    if (ret)
+        fdata = NULL;
+
+out:
+    free(fdata);
+    free(runs);
+    return ret;
+}
+
+/**
+ * @brief A file to deduplicate
+ */
+struct _star_dedup_key {
+    /** Hash of the file's data */
+    u64 hash;
+    /** Size of the file */
+    u64 size;
+    /** Index of the file */
+    u32 idx;
+};
+
+static int _star_dedup_key_cmp (const void * _l, const void * _r)
+{
+    const struct _star_dedup_key * l = _l;
+    const struct _star_dedup_key * r = _r;
+
+#define cmp(f) if (l->f != r->f) return (l->f < r->f) ? -1 : 1
+    cmp(hash);
+    cmp(size);
+    cmp(idx);
+#undef cmp
+
+    return 0;
+}
+
+/**
+ * @brief State of the threads hashing files for `star_dedup()`
+ */
+struct _star_dedup {
+    /** The STAR */
+    const struct STAR * self;
+    /** The files, in order of index */
+    struct _star_dedup_key * keys;
+};
+
+static void _star_dedup_hash (void * _ctx, size_t i)
+{
+    struct _star_dedup * ctx = _ctx;
+    ctx->keys[i].hash = hash64(ctx->self->fdata[i], ctx->self->fheaders[i].size, 0);
+}
+
+bool star_dedup (struct STAR * self, unsigned nthreads)
+{
+    bool ret = false;
+    struct _star_dedup_key * keys = NULL;
+    u32 * same = NULL;
+
+    ifjmp(!_star_check_ptrs(self), out);
+
+    /* already done */
+    ret = self->same != NULL;
+    ifjmp(ret, out);
+
+    u32 n = self->header.nfiles;
+
+    keys = malloc(n * sizeof(struct _star_dedup_key));
+    ifjmp(keys == NULL, out);
+
+    same = malloc(n * sizeof(u32));
+    ifjmp(same == NULL, out);
+
+    for (u32 i = 0; i < n; i++) {
+        keys[i].size = self->fheaders[i].size;
+        keys[i].idx = i;
+        same[i] = i;
+    }
+
+    struct _star_dedup ctx = { .self = self, .keys = keys };
+    par_for(n, nthreads, _star_dedup_hash, &ctx);
+
+    /* files with the same hash and size end up together, by index */
+    qsort(keys, n, sizeof(struct _star_dedup_key), _star_dedup_key_cmp);
+
+    for (u32 first = 0, last = 0; first < n; first = last) {
+        for (last = first + 1; last < n
+                && keys[last].hash == keys[first].hash
+                && keys[last].size == keys[first].size; last++)
+            ;
+
+        /* same hash, different data, is possible, if unlikely */
+        for (u32 k = first + 1; k < last; k++) {
+            u32 i = keys[k].idx;
+
+            for (u32 m = first; m < k && same[i] == i; m++) {
+                u32 j = keys[m].idx;
+                if (same[j] == j
+                        && memcmp(self->fdata[i], self->fdata[j], keys[k].size) == 0)
+                    same[i] = j;
+            }
+        }
+    }
+
+    for (u32 i = 0; i < n; i++) {
+        if (same[i] != i) {
+            free(self->fdata[i]);
+            self->fdata[i] = NULL;
+        }
+    }
+
+    self->same = same;
+    same = NULL;
+    ret = true;
+
+out:
+    free(same);
+    free(keys);
+    return ret;
+}
+
+/*
+ * Content defined chunking, as in FastCDC: a Gear hash rolls over the
+ * data, and a chunk ends where the hash has some bits unset; before the
+ * average size, more bits have to be unset than after it, so chunk
+ * sizes stay close to the average.
+ */
+
+/** Minimum size of a chunk, in bytes */
+#define STAR_CHUNK_MIN (1 << 12)
+/** Average size of a chunk, in bytes */
+#define STAR_CHUNK_AVG (1 << 14)
+/** Maximum size of a chunk, in bytes */
+#define STAR_CHUNK_MAX (1 << 16)
+/** Bits of the hash that must be unset before the average size */
+#define STAR_CHUNK_MASK_S (UINT64_C(0xFFFF) << 48)
+/** Bits of the hash that must be unset after the average size */
+#define STAR_CHUNK_MASK_L (UINT64_C(0xFFF) << 52)
+
+/**
+ * @brief Fill the Gear hash table, the same way every time (SplitMix64)
+ * @param gear The table
+ */
+static void _star_chunk_gear (u64 gear[UCHAR_MAX + 1])
+{
+    u64 x = 0;
+
+    for (size_t i = 0; i <= UCHAR_MAX; i++) {
+        u64 z = (x += UINT64_C(0x9E3779B97F4A7C15));
+        z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+        gear[i] = z ^ (z >> 31);
+    }
+}
+
+/**
+ * @brief Find where the chunk starting at @a data ends
+ * @param gear The Gear hash table
+ * @param data The data
+ * @param size Size of @a data, in bytes
+ * @returns Size of the chunk, in bytes
+ */
+static u32 _star_chunk_cut (const u64 * gear, const u8 * data, u64 size)
+{
+    if (size <= STAR_CHUNK_MIN)
+        return (u32) size;
+
+    u32 n = (u32) min(size, (u64) STAR_CHUNK_MAX);
+    u32 avg = min(n, (u32) STAR_CHUNK_AVG);
+    u64 h = 0;
+    u32 i = STAR_CHUNK_MIN;
+
+    for (; i < avg; i++) {
+        h = (h << 1) + gear[data[i]];
+        if ((h & STAR_CHUNK_MASK_S) == 0)
+            return i + 1;
+    }
+
+    for (; i < n; i++) {
+        h = (h << 1) + gear[data[i]];
+        if ((h & STAR_CHUNK_MASK_L) == 0)
+            return i + 1;
+    }
+
+    return n;
+}
+
+/**
+ * @brief A chunk found by `star_chunk()`
+ */
+struct _star_chunk_key {
+    /** Hash of the chunk's data */
+    u64 hash;
+    /** The chunk's data */
+    const u8 * data;
+    /** Size of the chunk, in bytes */
+    u32 size;
+};
+
+/**
+ * @brief State of the threads splitting files for `star_chunk()`
+ */
+struct _star_chunk {
+    /** The STAR */
+    const struct STAR * self;
+    /** The Gear hash table */
+    u64 gear[UCHAR_MAX + 1];
+    /** For each file, its chunks, or `NULL` if it isn't to be split */
+    struct _star_chunk_key ** keys;
+    /** For each file, the number of chunks */
+    u32 * nkeys;
+};
+
+static void _star_chunk_split (void * _ctx, size_t i)
+{
+    struct _star_chunk * ctx = _ctx;
+    const u8 * data = ctx->self->fdata[i];
+    u64 size = ctx->self->fheaders[i].size;
+
+    /* files sharing another's data share its chunks too */
+    if (data == NULL)
+        return;
+
+    /* room for the worst case, given back at the end */
+    struct _star_chunk_key * keys = malloc(
+            (size / STAR_CHUNK_MIN + 1) * sizeof(struct _star_chunk_key));
+    if (keys == NULL)
+        return;
+
+    u32 n = 0;
+    for (u64 off = 0; off < size; n++) {
+        u32 len = _star_chunk_cut(ctx->gear, data + off, size - off);
+        keys[n].hash = hash64(data + off, len, 0);
+        keys[n].data = data + off;
+        keys[n].size = len;
+        off += len;
+    }
+
+    struct _star_chunk_key * tmp = realloc(keys, (n + 1) * sizeof(struct _star_chunk_key));
+    ctx->keys[i] = (tmp != NULL) ? tmp : keys;
+    ctx->nkeys[i] = n;
+}
+
+bool star_chunk (struct STAR * self, unsigned nthreads)
+{
+    bool ret = false;
+    struct _star_chunk * ctx = NULL;
+    struct _star_chunk_key ** table = NULL;
+    const struct StarChunk ** owners = NULL;
+
+    ifjmp(!_star_check_ptrs(self), out);
+
+    u32 n = self->header.nfiles;
+
+    ctx = calloc(1, sizeof(struct _star_chunk));
+    ifjmp(ctx == NULL, out);
+
+    ctx->self = self;
+    ctx->keys = calloc(n, sizeof(struct _star_chunk_key *));
+    ctx->nkeys = calloc(n, sizeof(u32));
+    ifjmp(ctx->keys == NULL || ctx->nkeys == NULL, out);
+
+    _star_chunk_gear(ctx->gear);
+    par_for(n, nthreads, _star_chunk_split, ctx);
+
+    /* some file couldn't be split */
+    for (u32 i = 0; i < n; i++)
+        ifjmp(self->fdata[i] != NULL && ctx->keys[i] == NULL, out);
+
+    /* open addressing table of distinct chunks, at most half full */
+    u64 nchunks = 0;
+    for (u32 i = 0; i < n; i++)
+        nchunks += ctx->nkeys[i];
+
+    u64 cap = 1;
+    while (cap < 2 * nchunks)
+        cap <<= 1;
+
+    table = calloc(cap, sizeof(struct _star_chunk_key *));
+    owners = calloc(cap, sizeof(struct StarChunk *));
+    ifjmp(table == NULL || owners == NULL, out);
+
+    for (u32 i = 0; i < n; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+        u32 same = (self->same != NULL) ? self->same[i] : i;
+
+        fh->nchunks = (same != i) ?
+            self->fheaders[same].nchunks :
+            ctx->nkeys[i] ;
+        fh->chunks = calloc(fh->nchunks, sizeof(struct StarChunk));
+        ifjmp(fh->chunks == NULL && fh->nchunks > 0, out);
+        fh->flags |= STAR_F_CHUNKED;
+
+        if (same != i) { /* share every chunk of the file it shares data with */
+            for (u32 c = 0; c < fh->nchunks; c++) {
+                const struct StarChunk * o = self->fheaders[same].chunks + c;
+                fh->chunks[c].start = o->start;
+                fh->chunks[c].size = o->size;
+                fh->chunks[c].csize = o->size;
+                fh->chunks[c].same = (o->same != NULL) ? o->same : o;
+            }
+            continue;
+        }
+
+        for (u32 c = 0; c < fh->nchunks; c++) {
+            struct _star_chunk_key * key = ctx->keys[i] + c;
+            u64 slot = key->hash & (cap - 1);
+
+            /* same hash, different data, is possible, if unlikely */
+            while (table[slot] != NULL
+                    && (table[slot]->hash != key->hash
+                        || table[slot]->size != key->size
+                        || memcmp(table[slot]->data, key->data, key->size) != 0))
+                slot = (slot + 1) & (cap - 1);
+
+            fh->chunks[c].start = (u64) (key->data - self->fdata[i]);
+            fh->chunks[c].size = key->size;
+            fh->chunks[c].csize = key->size;
+
+            if (table[slot] != NULL) {
+                fh->chunks[c].same = owners[slot];
+            } else {
+                table[slot] = key;
+                owners[slot] = fh->chunks + c;
+            }
+        }
+    }
+
+    ret = true;
+
+out:
+    if (ctx != NULL) {
+        for (u32 i = 0; ctx->keys != NULL && i < n; i++)
+            free(ctx->keys[i]);
+        free(ctx->keys);
+        free(ctx->nkeys);
+    }
+    free(ctx);
+    free(table);
+    free(owners);
+    return ret;
+}
+
+/**
+ * @brief Size of the blocks `star_compress()` splits big files in, that
+ *     aren't split in chunks yet, in bytes
+ */
+#define STAR_BLOCK_SIZE (1 << 18)
+
+/**
+ * @brief Biggest file `star_solid()` puts in a solid block, in bytes
+ */
+#define STAR_SOLID_MAX (1 << 14)
+
+bool star_solid (struct STAR * self)
+{
+    bool ret = false;
+    struct StarBlock * blocks = NULL;
+    u8 ** bdata = NULL;
+    u32 nblocks = 0;
+
+    ifjmp(!_star_check_ptrs(self), out);
+
+    /* already done */
+    ret = self->blocks != NULL;
+    ifjmp(ret, out);
+
+    /* too late, blocks have to be compressed too */
+    ifjmp(self->cdata != NULL, out);
+
+    u32 n = self->header.nfiles;
+
+    /* at worst, a block per file */
+    blocks = calloc(n, sizeof(struct StarBlock));
+    ifjmp(blocks == NULL, out);
+
+    /* neighbours go together, until the block is full */
+    for (u32 i = 0; i < n; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+        u32 same = (self->same != NULL) ? self->same[i] : i;
+
+        if (same != i
+                || (fh->flags & STAR_F_CHUNKED)
+                || fh->size == 0
+                || fh->size > STAR_SOLID_MAX)
+            continue;
+
+        if (nblocks == 0 || blocks[nblocks - 1].size + fh->size > STAR_BLOCK_SIZE)
+            nblocks++;
+
+        struct StarBlock * b = blocks + nblocks - 1;
+        fh->flags |= STAR_F_SOLID;
+        fh->block = nblocks - 1;
+        fh->offset = b->size;
+        b->size += (u32) fh->size;
+        b->csize = b->size;
+    }
+
+    /* files that share data with a solid file share its place too */
+    for (u32 i = 0; i < n; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+        u32 same = (self->same != NULL) ? self->same[i] : i;
+
+        if (same != i && (self->fheaders[same].flags & STAR_F_SOLID)) {
+            fh->flags |= STAR_F_SOLID;
+            fh->block = self->fheaders[same].block;
+            fh->offset = self->fheaders[same].offset;
+        }
+    }
+
+    ret = nblocks == 0;
+    ifjmp(ret, out);
+
+    bdata = calloc(nblocks, sizeof(u8 *));
+    ifjmp(bdata == NULL, ko);
+
+    for (u32 b = 0; b < nblocks; b++) {
+        bdata[b] = malloc(blocks[b].size);
+        ifjmp(bdata[b] == NULL, ko);
+    }
+
+    for (u32 i = 0; i < n; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+        if ((fh->flags & STAR_F_SOLID) && self->fdata[i] != NULL)
+            memcpy(bdata[fh->block] + fh->offset, self->fdata[i], fh->size);
+    }
+
+    struct StarBlock * tmp = realloc(blocks, nblocks * sizeof(struct StarBlock));
+    self->blocks = (tmp != NULL) ? tmp : blocks;
+    self->bdata = bdata;
+    self->header.nblocks = nblocks;
+    blocks = NULL;
+    ret = true;
+
+out:
+    free(blocks);
+    return ret;
+
+ko:
+    for (u32 i = 0; i < n; i++)
+        self->fheaders[i].flags &= (u8) ~STAR_F_SOLID;
+    for (u32 b = 0; bdata != NULL && b < nblocks; b++)
+        free(bdata[b]);
+    free(bdata);
+    ret = false;
+    goto out;
+}
+
+/*
+ * Dictionary training, as in COVER: the samples are cut in segments,
+ * and each segment is scored by how many samples the substrings in it
+ * are found in; the best segments make the dictionary, and substrings
+ * already in it no longer count for the segments that come after.
+ */
+
+/** Biggest dictionary `star_train()` makes, in bytes */
+#define STAR_DICT_SIZE (1 << 15)
+/** Bytes of the beggining of each file `star_train()` samples, at most */
+#define STAR_DICT_SAMPLE (1 << 12)
+/** Bytes `star_train()` samples in total, at most */
+#define STAR_DICT_SAMPLES (1 << 22)
+/** Size of the segments `star_train()` makes the dictionary of, in bytes */
+#define STAR_DICT_SEGMENT 64
+/** Size of the substrings `star_train()` counts, in bytes */
+#define STAR_DICT_K 8
+/** Bits of the hash `star_train()` counts substrings by */
+#define STAR_DICT_BITS 20
+
+/**
+ * @brief A segment of the samples of `star_train()`
+ */
+struct _star_train_seg {
+    /** Sum of the number of samples with each substring of the segment */
+    u64 score;
+    /** Offset of the segment in the samples */
+    u32 off;
+    /** Size of the segment, in bytes */
+    u32 size;
+};
+
+/**
+ * @brief Check if segment @a l is better than segment @a r
+ * @returns `true` if it has a higher score, or the same score and
+ *     comes first, `false` otherwise
+ */
+static inline bool _star_train_seg_better (const struct _star_train_seg * l, const struct _star_train_seg * r)
+{
+    return l->score > r->score
+        || (l->score == r->score && l->off < r->off);
+}
+
+/**
+ * @brief Move the segment at @a i of the heap @a heap down to its place
+ * @param heap The segments, the best first
+ * @param n Number of segments in @a heap
+ * @param i Index of the segment
+ */
+static void _star_train_sift (struct _star_train_seg * heap, u32 n, u32 i)
+{
+    struct _star_train_seg seg = heap[i];
+
+    for (u32 c; (c = 2 * i + 1) < n; i = c) {
+        if (c + 1 < n && _star_train_seg_better(heap + c + 1, heap + c))
+            c++;
+        if (!_star_train_seg_better(heap + c, &seg))
+            break;
+        heap[i] = heap[c];
+    }
+
+    heap[i] = seg;
+}
+
+/**
+ * @brief Hash the substring at @a p for `star_train()`
+ * @param p The substring, `STAR_DICT_K` bytes
+ * @returns The hash, `STAR_DICT_BITS` wide
+ */
+static inline u32 _star_train_hash (const u8 * p)
+{
+    u64 v = 0;
+    for (size_t i = 0; i < STAR_DICT_K; i++)
+        v |= (u64) p[i] << (i * CHAR_BIT);
+    return (u32) ((v * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - STAR_DICT_BITS));
+}
+
+/**
+ * @brief Score a segment with the current counts of its substrings
+ * @param count Number of samples with each substring, by hash
+ * @param seg The segment
+ * @param size Size of the segment, in bytes
+ * @returns The score
+ */
+static u64 _star_train_score (const u32 * count, const u8 * seg, u32 size)
 {
     u64 ret = 0;
 
-    ifjmp(self == NULL, out);
-    ifjmp(in == NULL, out);
+    /* substrings found in only one sample are no use */
+    for (u32 p = 0; p + STAR_DICT_K <= size; p++)
+        ret += count[_star_train_hash(seg + p)] - 1;
+
+    return ret;
+}
+
+bool star_train (struct STAR * self)
+{
+    bool ret = false;
+    u8 * samples = NULL;
+    u32 * count = NULL;
+    u32 * seen = NULL;
+    struct _star_train_seg * segs = NULL;
+    u8 * dict = NULL;
+
+    ifjmp(!_star_check_ptrs(self), out);
+
+    /* already done */
+    ret = self->dict != NULL;
+    ifjmp(ret, out);
+
+    /* too late, files have to be compressed against it */
+    ifjmp(self->cdata != NULL, out);
+
+    u32 n = self->header.nfiles;
+
+    /* files sharing another's data would only count it twice */
+    u64 total = 0;
+    for (u32 i = 0; i < n; i++)
+        if (self->fdata[i] != NULL)
+            total += min(self->fheaders[i].size, (u64) STAR_DICT_SAMPLE);
+
+    /* too many, sample every so many files */
+    u64 step = total / STAR_DICT_SAMPLES + 1;
+
+    u64 cap = min(total, (u64) STAR_DICT_SAMPLES);
+
+    samples = malloc(cap + 1);
+    count = calloc((size_t) 1 << STAR_DICT_BITS, sizeof(u32));
+    seen = calloc((size_t) 1 << STAR_DICT_BITS, sizeof(u32));
+    ifjmp(samples == NULL || count == NULL || seen == NULL, out);
+
+    /* count each substring once per sample */
+    u32 size = 0;
+    u32 nsegs = 0;
+    u32 nsamples = 0;
+    for (u32 i = 0, k = 0; i < n; i++) {
+        if (self->fdata[i] == NULL || self->fheaders[i].size == 0 || k++ % step != 0)
+            continue;
+
+        u32 len = (u32) min(self->fheaders[i].size, (u64) STAR_DICT_SAMPLE);
+        if (size + len > cap)
+            break;
+
+        const u8 * sample = memcpy(samples + size, self->fdata[i], len);
+
+        nsamples++;
+        for (u32 p = 0; p + STAR_DICT_K <= len; p++) {
+            u32 h = _star_train_hash(sample + p);
+            if (seen[h] != nsamples) {
+                seen[h] = nsamples;
+                count[h]++;
+            }
+        }
+
+        size += len;
+        nsegs += (len - 1) / STAR_DICT_SEGMENT + 1;
+    }
+
+    /* nothing in common, with just one sample */
+    ret = nsamples < 2;
+    ifjmp(ret, out);
+
+    segs = malloc(nsegs * sizeof(struct _star_train_seg));
+    ifjmp(segs == NULL, out);
+
+    /* segments don't cross from a sample to the next */
+    nsegs = 0;
+    for (u32 i = 0, k = 0, off = 0; i < n && off < size; i++) {
+        if (self->fdata[i] == NULL || self->fheaders[i].size == 0 || k++ % step != 0)
+            continue;
+
+        u32 len = (u32) min(self->fheaders[i].size, (u64) STAR_DICT_SAMPLE);
+        for (u32 p = 0; p < len; p += STAR_DICT_SEGMENT) {
+            struct _star_train_seg * seg = segs + nsegs++;
+            seg->off = off + p;
+            seg->size = min(len - p, (u32) STAR_DICT_SEGMENT);
+            seg->score = _star_train_score(count, samples + seg->off, seg->size);
+        }
+
+        off += len;
+    }
+
+    for (u32 i = nsegs / 2; i-- > 0; )
+        _star_train_sift(segs, nsegs, i);
+
+    dict = malloc(STAR_DICT_SIZE);
+    ifjmp(dict == NULL, out);
+
+    /*
+     * scores only go down as the dictionary grows, so the best segment
+     * is the one at the top of the heap, if its score is still the same;
+     * the best segments go last, closest to the data
+     */
+    u32 dsize = 0;
+    while (nsegs > 0 && segs[0].score > 0) {
+        const u8 * seg = samples + segs[0].off;
+        u32 len = segs[0].size;
+
+        if (dsize + len > STAR_DICT_SIZE)
+            break;
+
+        u64 score = _star_train_score(count, seg, len);
+        if (score != segs[0].score) {
+            segs[0].score = score;
+            _star_train_sift(segs, nsegs, 0);
+            continue;
+        }
+
+        segs[0] = segs[--nsegs];
+        _star_train_sift(segs, nsegs, 0);
+
+        for (u32 p = 0; p + STAR_DICT_K <= len; p++)
+            count[_star_train_hash(seg + p)] = 1;
+
+        dsize += len;
+        memcpy(dict + STAR_DICT_SIZE - dsize, seg, len);
+    }
+
+    ret = true;
+    ifjmp(dsize == 0, out);
+
+    memmove(dict, dict + STAR_DICT_SIZE - dsize, dsize);
+    self->dict = dict;
+    self->header.dsize = dsize;
+    dict = NULL;
+
+out:
+    free(dict);
+    free(segs);
+    free(seen);
+    free(count);
+    free(samples);
+    return ret;
+}
+
+/**
+ * @brief A file, chunk, or solid block, to compress for `star_compress()`
+ */
+struct _star_compress_piece {
+    /** Index of the file, or of the solid block */
+    u32 file;
+    /** The chunk, `NULL` if the whole file */
+    struct StarChunk * chunk;
+    /** The solid block, `NULL` if a file or chunk */
+    struct StarBlock * block;
+    /** Offset of the data in the file's data */
+    u64 off;
+    /** Where to compress to in the file's stored data, before it's
+     *  packed: the same offset as the data, not counting shared chunks */
+    u64 coff;
+    /** Stored as is: found incompressible by `_star_incompressible()`,
+     *  or it didn't get any smaller */
+    bool raw;
+};
+
+/**
+ * @brief State of the threads compressing for `star_compress()`
+ */
+struct _star_compress {
+    /** The STAR */
+    struct STAR * self;
+    /** The codec */
+    u8 codec;
+    /** The dictionary, if `STAR_CODEC_LZ_DICT` */
+    LzDict dict;
+    /** What to compress, in order */
+    struct _star_compress_piece * pieces;
+};
+
+/**
+ * @brief Encode @a size bytes of @a in with @a codec to @a out
+ * @param dict The dictionary, if `STAR_CODEC_LZ_DICT`
+ * @param codec The codec
+ * @param in The data
+ * @param size Size of the data, in bytes
+ * @param out Where to encode to, with room for @a size bytes
+ * @returns Size of the data as stored, in bytes
+ */
+static u32 _star_encode (const LzDict * dict, u8 codec, const u8 * in, u32 size, u8 * out)
+{
+    /* has to get smaller, or it's stored as is */
+    size_t csize = 0;
+
+    switch (codec) {
+        case STAR_CODEC_LZ:
+            csize = (size > 0) ? lz_compress(in, size, out, size - 1) : 0;
+            break;
+        case STAR_CODEC_LZ_DICT:
+            csize = (size > 0) ? lz_compress_dict(dict, in, size, out, size - 1) : 0;
+            break;
+    }
+
+    if (csize == 0) {
+        memcpy(out, in, size);
+        csize = size;
+    }
+
+    return (u32) csize;
+}
+
+/**
+ * @brief Smallest piece of data `_star_incompressible()` probes, in
+ *     bytes; smaller ones cost little to just compress
+ */
+#define STAR_PROBE_MIN (1 << 14)
+
+/**
+ * @brief Size of each sample `_star_incompressible()` compresses, in bytes
+ */
+#define STAR_PROBE_SAMPLE (1 << 11)
+
+/**
+ * @brief Number of samples `_star_incompressible()` compresses
+ */
+#define STAR_PROBE_SAMPLES 4
+
+/**
+ * @brief Check if @a size bytes of @a data are unlikely to compress,
+ *     by compressing a few samples of it, spread over it
+ * @param data The data
+ * @param size Size of the data, in bytes
+ * @returns `true` if the samples got less than about 3% smaller,
+ *     `false` otherwise, or if the data is too small to probe
+ *
+ * Already compressed data (images, archives, ...) is found at a small
+ * fraction of the cost of compressing all of it, for nothing.
+ */
+static bool _star_incompressible (const u8 * data, u32 size)
+{
+    u8 buf[STAR_PROBE_SAMPLE];
+
+    if (size < STAR_PROBE_MIN)
+        return false;
+
+    u64 csize = 0;
+    u32 stride = (size - STAR_PROBE_SAMPLE) / (STAR_PROBE_SAMPLES - 1);
+
+    for (u32 s = 0; s < STAR_PROBE_SAMPLES; s++) {
+        /* didn't get smaller, it'd be stored as is */
+        size_t n = lz_compress(data + s * stride, STAR_PROBE_SAMPLE, buf, sizeof(buf));
+        csize += (n > 0) ? n : STAR_PROBE_SAMPLE;
+    }
+
+    return csize * 32 > (u64) STAR_PROBE_SAMPLES * STAR_PROBE_SAMPLE * 31;
+}
+
+static void _star_compress_piece (void * _ctx, size_t i)
+{
+    struct _star_compress * ctx = _ctx;
+    struct _star_compress_piece * p = ctx->pieces + i;
+    struct STAR * self = ctx->self;
+
+    if (p->block != NULL) {
+        p->raw = _star_incompressible(self->bdata[p->file], p->block->size);
+        p->block->codec = ctx->codec;
+        if (p->raw)
+            return;
+
+        /* stays as is if there's no memory to compress it */
+        u8 * cdata = malloc(p->block->size);
+        if (cdata == NULL)
+            return;
+
+        p->block->csize = _star_encode(&ctx->dict, ctx->codec, self->bdata[p->file], p->block->size, cdata);
+        free(self->bdata[p->file]);
+        self->bdata[p->file] = cdata;
+        return;
+    }
+
+    struct StarFileHeader * fh = self->fheaders + p->file;
+    const u8 * data = self->fdata[p->file] + p->off;
+    u8 * cdata = self->cdata[p->file] + p->coff;
+
+    /* files bigger than a block are in chunks by now */
+    u32 size = (p->chunk != NULL) ? p->chunk->size : (u32) fh->size;
+
+    /* no codec, stored as is */
+    u8 codec = _star_incompressible(data, size) ?
+        STAR_CODEC_NONE :
+        ctx->codec ;
+    u32 csize = _star_encode(&ctx->dict, codec, data, size, cdata);
+    p->raw = size > 0 && csize == size;
+
+    if (p->chunk != NULL)
+        p->chunk->csize = csize;
+    else
+        fh->csize = csize;
+}
+
+/**
+ * @brief Split the big files of @a self that aren't split in chunks
+ *     yet in blocks of `STAR_BLOCK_SIZE`, to compress (or checksum, see
+ *     `star_chunk_crc()`) on their own
+ * @param self The STAR
+ * @returns `true` if successful, `false` otherwise
+ */
+static bool _star_compress_blocks (struct STAR * self)
+{
+    for (u32 i = 0; i < self->header.nfiles; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+        u32 same = (self->same != NULL) ? self->same[i] : i;
+
+        if ((fh->flags & STAR_F_CHUNKED) || fh->size <= STAR_BLOCK_SIZE)
+            continue;
+
+        fh->nchunks = (u32) ((fh->size - 1) / STAR_BLOCK_SIZE + 1);
+        fh->chunks = calloc(fh->nchunks, sizeof(struct StarChunk));
+        if (fh->chunks == NULL) {
+            fh->nchunks = 0;
+            return false;
+        }
+        fh->flags |= STAR_F_CHUNKED;
+
+        for (u32 c = 0; c < fh->nchunks; c++) {
+            fh->chunks[c].start = (u64) c * STAR_BLOCK_SIZE;
+            fh->chunks[c].size = (u32) min(fh->size - fh->chunks[c].start, (u64) STAR_BLOCK_SIZE);
+            fh->chunks[c].csize = fh->chunks[c].size;
+
+            /* share every block of the file it shares data with */
+            if (same != i)
+                fh->chunks[c].same = self->fheaders[same].chunks + c;
+        }
+    }
+
+    return true;
+}
+
+bool star_compress (struct STAR * self, u8 codec, unsigned nthreads)
+{
+    bool ret = false;
+    struct _star_compress ctx = { .self = self, .codec = codec };
+
+    ifjmp(!_star_check_ptrs(self), out);
+    ifjmp(codec > STAR_CODEC_LZ_DICT, out);
+
+    /* already done */
+    ret = self->cdata != NULL;
+    ifjmp(ret || codec == STAR_CODEC_NONE, out);
+
+    /* nothing to compress against */
+    if (codec == STAR_CODEC_LZ_DICT && self->dict == NULL)
+        ctx.codec = codec = STAR_CODEC_LZ;
+
+    ifjmp(codec == STAR_CODEC_LZ_DICT
+            && !lz_dict_init(&ctx.dict, self->dict, self->header.dsize), out);
+
+    u32 n = self->header.nfiles;
+
+    ifjmp(!_star_compress_blocks(self), out);
+
+    self->cdata = calloc(n, sizeof(u8 *));
+    ifjmp(self->cdata == NULL, out);
+
+    /* one piece per file or chunk with its own data */
+    u64 npieces = 0;
+    for (u32 i = 0; i < n; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+
+        /* files sharing another's data share its encoding too, and
+         * solid files are compressed with their block */
+        if (self->fdata[i] == NULL || (fh->flags & STAR_F_SOLID))
+            continue;
+
+        /* never bigger than the data */
+        self->cdata[i] = malloc(fh->size);
+        ifjmp(self->cdata[i] == NULL && fh->size > 0, ko);
+
+        npieces += (fh->flags & STAR_F_CHUNKED) ? fh->nchunks : 1;
+    }
+
+    npieces += self->header.nblocks;
+
+    ctx.pieces = malloc(npieces * sizeof(struct _star_compress_piece));
+    ifjmp(ctx.pieces == NULL && npieces > 0, ko);
 
-    u8 ** fdata = (self->fdata == NULL) ?
-        calloc(self->header.nfiles, sizeof(u8 *)) :
-        self->fdata ;
-    ifjmp(fdata == NULL, out);
+    npieces = 0;
+    for (u32 b = 0; b < self->header.nblocks; b++)
+        ctx.pieces[npieces++] = (struct _star_compress_piece) {
+            .file = b,
+            .block = self->blocks + b,
+        };
 
-    /* assume `fdata` has enough space */
-    for (ret = 0; ret < self->header.nfiles; ret++) {
-        fdata[ret] = malloc(self->fheaders[ret].size);
-        if (fdata[ret] == NULL)
-            break;
+    for (u32 i = 0; i < n; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
 
-        if (!star_read_u8_single(fdata[ret], in, self->fheaders[ret].size)) {
-            free(fdata[ret]);
-            fdata[ret] = NULL;
-            break;
+        fh->codec = codec;
+
+        if (self->fdata[i] == NULL || (fh->flags & STAR_F_SOLID))
+            continue;
+
+        if (!(fh->flags & STAR_F_CHUNKED)) {
+            ctx.pieces[npieces++] = (struct _star_compress_piece) { .file = i };
+            continue;
+        }
+
+        u64 off = 0;
+        u64 coff = 0;
+        for (u32 c = 0; c < fh->nchunks; off += fh->chunks[c].size, c++) {
+            if (fh->chunks[c].same != NULL)
+                continue;
+
+            ctx.pieces[npieces++] = (struct _star_compress_piece) {
+                .file = i,
+                .chunk = fh->chunks + c,
+                .off = off,
+                .coff = coff,
+            };
+            coff += fh->chunks[c].size;
         }
     }
 
-    self->fdata = fdata;
+    /* pieces are compressed in any order, but always end up the same */
+    par_for(npieces, nthreads, _star_compress_piece, &ctx);
+
+    for (u64 k = 0, end = 0; k < npieces; k++) {
+        const struct _star_compress_piece * p = ctx.pieces + k;
+
+        if (k == 0 || p->file != p[-1].file)
+            end = 0;
+
+        if (p->chunk != NULL && p->block == NULL) {
+            memmove(self->cdata[p->file] + end, self->cdata[p->file] + p->coff, p->chunk->csize);
+            end += p->chunk->csize;
+        }
+    }
+
+    /* files whose own data was all stored as is */
+    for (u64 k = 0; k < npieces; k++) {
+        const struct _star_compress_piece * p = ctx.pieces + k;
+        struct StarFileHeader * fh = self->fheaders + p->file;
+
+        if (p->block != NULL)
+            continue;
+
+        /* the first piece of a file sets it, any other may clear it */
+        bool first = k == 0 || p[-1].block != NULL || p[-1].file != p->file;
+        if (first && p->raw)
+            fh->flags |= STAR_F_INCOMPRESSIBLE;
+        else if (!p->raw)
+            fh->flags &= (u8) ~STAR_F_INCOMPRESSIBLE;
+    }
+
+    /* what's shared is stored the way it was for its owner */
+    for (u32 i = 0; i < n; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+
+        for (u32 c = 0; c < fh->nchunks; c++)
+            if (fh->chunks[c].same != NULL)
+                fh->chunks[c].csize = fh->chunks[c].same->csize;
+
+        if (self->same != NULL && self->same[i] != i) {
+            fh->csize = self->fheaders[self->same[i]].csize;
+            fh->flags |= self->fheaders[self->same[i]].flags & STAR_F_INCOMPRESSIBLE;
+        }
+    }
+
+    ret = true;
 
 out:
+    lz_dict_free(&ctx.dict);
+    free(ctx.pieces);
     return ret;
+
+ko:
+    for (u32 i = 0; i < n; i++) {
+        free(self->cdata[i]);
+        self->fheaders[i].codec = STAR_CODEC_NONE;
+    }
+    free(self->cdata);
+    self->cdata = NULL;
+    goto out;
 }
 
-struct STAR * star_read (Stream * in)
+static void _star_chunk_crc_file (void * _self, size_t i)
 {
-    struct STAR * ret = NULL;
-    struct STAR tmp = {0};
+    struct STAR * self = _self;
+    struct StarFileHeader * fh = self->fheaders + i;
+    const u8 * data = self->fdata[i];
 
-    /* failed to read header or `in` is not a STAR file */
-    ifjmp(!star_read_header(&tmp, in), out);
+    /* files sharing another's data share its chunks too */
+    if (data == NULL)
+        return;
 
-    { /* allocate and copy the already read data */
-        ret = malloc(sizeof(struct STAR));
-        ifjmp(ret == NULL, out);
-        *ret = tmp;
-    }
+    for (u32 c = 0; c < fh->nchunks; c++)
+        fh->chunks[c].crc = crc32c(0, data + fh->chunks[c].start, fh->chunks[c].size);
+}
 
-    /*
-     * if it wasnt possible to read everything, return NULL
-     */
-    /* number of successfully read file headers */
-    u64 nfheaders = star_read_fheaders(ret, in);
-    ifjmp(ret->header.nfiles != nfheaders, ko_fheaders);
+bool star_chunk_crc (struct STAR * self, unsigned nthreads)
+{
+    if (!_star_check_ptrs(self) || !_star_compress_blocks(self))
+        return false;
 
-    /* number of successfully read files */
-    u64 nfdata = star_read_fdata(ret, in);
-    ifjmp(ret->header.nfiles != nfdata, ko_fdata);
+    par_for(self->header.nfiles, nthreads, _star_chunk_crc_file, self);
 
-out:
-    return ret;
+    /* chunk checksums make the file's, so it needs one too */
+    for (u32 i = 0; i < self->header.nfiles; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
 
-ko_fdata:
-    for (u64 i = 0; i < nfdata; i++)
-        free(ret->fdata[i]);
-    free(ret->fdata);
+        if (!(fh->flags & STAR_F_CHUNKED) || !(fh->flags & STAR_F_CHECKSUM))
+            continue;
 
-ko_fheaders:
-    for (u64 i = 0; i < nfheaders; i++)
-        free(ret->fheaders[i].path);
-    free(ret->fheaders);
+        if (self->fdata[i] == NULL)
+            for (u32 c = 0; c < fh->nchunks; c++)
+                fh->chunks[c].crc = fh->chunks[c].same->crc;
 
-    free(ret);
-    ret = NULL;
-    goto out;
+        fh->flags |= STAR_F_CHUNK_CHECKSUM;
+    }
+
+    return true;
 }
 
-/***********************************************************
- * write functions (assume `out` was opened in write mode)
- **********************************************************/
+/**
+ * @brief Align @a offset, where data of @a size goes, as asked in @a self
+ * @param self The STAR, whose `padding` grows with what's skipped
+ * @param offset Where the data would go, packed
+ * @param size Size of the data, in bytes
+ * @returns Where the data goes
+ */
+static u64 _star_align (struct STAR * self, u64 offset, u64 size)
+{
+    if (self->align < 2 || size < self->align_min || size == 0)
+        return offset;
 
-/*
- * macro to define functions to write specific unsigned integer types
+    u64 pad = (self->align - offset % self->align) % self->align;
+    self->padding += pad;
+    return offset + pad;
+}
+
+/**
+ * @brief Set where the headers of @a self go, and its size, with its
+ *     data up to @a offset
+ * @param self The STAR
+ * @param offset End of the data of the files
  */
-#define _star_make_write_fun(name, type)                       \
-    bool name (const type * in, Stream * out, u64 nmemb) {     \
-        ifjmp(in == NULL, ko);                                 \
-        ifjmp(out == NULL, ko);                                \
-        u8 buf[sizeof(type)] = {0};                            \
-        for (u64 i = 0; i < nmemb; i++) {                      \
-            _star_uint_width_encode(buf, in[i], sizeof(type)); \
-            u64 w = stream_write(out, buf, sizeof(type), 1);   \
-            ifjmp(w != 1, ko);                                 \
-        }                                                      \
-        return true;                                           \
-    ko:                                                        \
-        return false;                                          \
-    } bool name (const type * in, Stream * out, u64 nmemb)
+static void _star_end_offsets (struct STAR * self, u64 offset)
+{
+    /* since version 11, the headers come after the data, and say how it's aligned */
+    u8 version = _star_version(self);
+    self->header.align = (version > 10) ? self->align : 0;
+    self->header.align_min = (version > 10) ? self->align_min : 0;
+    self->header.hoffset = (version > 10) ?
+        STAR_MAP_PAD(offset) :
+        _star_header_size(version) ;
+    self->size = (version > 10) ?
+        self->header.hoffset + _star_hsize(self, version) :
+        offset ;
+}
 
-/*
- * define functions to write specific unsigned integer types
+/**
+ * @brief Calculate the offsets of the files @a from and after of
+ *     @a self, with their data from @a offset on
+ * @param self The STAR, ready to be written, except for the file offsets
+ * @param from Index of the first file
+ * @param offset Where the data of the files goes
  */
-_star_make_write_fun(star_write_u8, u8);
-_star_make_write_fun(star_write_u32, u32);
-_star_make_write_fun(star_write_u64, u64);
+static void _star_file_offsets (struct STAR * self, u64 from, u64 offset)
+{
+    u32 nblocks = 0;
 
-#define star_write_u8_single(IN, OUT, SIZE) \
-        (stream_write((OUT), (IN), (SIZE), 1) == 1)
+    self->padding = 0;
+
+    /*
+     * files and chunks sharing data always come after the file or
+     * chunk they share it with
+     */
+    for (u64 i = from; i < self->header.nfiles; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+        u64 same = (self->same != NULL) ? self->same[i] : i;
+
+        /* blocks go where their first file would */
+        if (fh->flags & STAR_F_SOLID) {
+            if (fh->block == nblocks) {
+                offset = _star_align(self, offset, self->blocks[nblocks].size);
+                self->blocks[nblocks].offset = offset;
+                offset += self->blocks[nblocks].csize;
+                nblocks++;
+            }
+        } else if (fh->flags & STAR_F_CHUNKED) {
+            /* only its first own chunk is aligned, the rest follow it */
+            bool first = true;
+            fh->offset = offset;
 
-bool star_write_header (const struct STAR * self, Stream * out)
+            for (u32 c = 0; c < fh->nchunks; c++) {
+                struct StarChunk * chunk = fh->chunks + c;
+
+                if (chunk->same != NULL) {
+                    chunk->offset = chunk->same->offset;
+                } else {
+                    if (first)
+                        offset = fh->offset = _star_align(self, offset, fh->size);
+                    first = false;
+                    chunk->offset = offset;
+                    offset += chunk->csize;
+                }
+            }
+        } else if (same != i) {
+            fh->offset = self->fheaders[same].offset;
+        } else {
+            offset = _star_align(self, offset, fh->size);
+            fh->offset = offset;
+            offset += fh->csize;
+        }
+    }
+
+    _star_end_offsets(self, offset);
+}
+
+/*
+ * assume self is a complete `struct STAR`, ready to
+ * write, except for the file offsets
+ */
+bool star_file_offsets (struct STAR * self)
 {
-    if (self == NULL || out == NULL)
+    if (self == NULL)
         return false;
 
-    return star_write_u8_single(STAR_MAGIC, out, sizeof(STAR_MAGIC))
-        && star_write_u32(&self->header.nfiles, out, 1);
+    /* beggining of fdata */
+    _star_file_offsets(self, 0, _star_fdata_offset(self, _star_version(self)));
+    return true;
 }
 
-bool star_write_fheader (const struct StarFileHeader * fh, Stream * out)
+/**
+ * @brief Mark deleted the files of @a self with the same path as a
+ *     file added after them, @a first or after
+ * @param self The STAR
+ * @param first Index of the first file added
+ * @returns `true` if they were marked, `false` if there isn't enough
+ *     memory
+ */
+static bool _star_supersede (struct STAR * self, u32 first)
 {
-    if (fh == NULL || out == NULL)
+    u32 n = self->header.nfiles - first;
+    if (n == 0)
+        return true;
+
+    struct _star_map_name * names = malloc(n * sizeof(struct _star_map_name));
+    if (names == NULL)
         return false;
 
-    return star_write_u32(&fh->size,      out, 1)
-        && star_write_u64(&fh->offset,    out, 1)
-        && star_write_u8(&fh->path_len,   out, 1)
-        && star_write_u8_single(fh->path, out, fh->path_len);
+    for (u32 i = 0; i < n; i++)
+        names[i] = (struct _star_map_name) { self->fheaders[first + i].path, first + i };
+    qsort(names, n, sizeof(struct _star_map_name), _star_map_name_cmp);
+
+    for (u32 i = 0; i < self->header.nfiles; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
+
+        /* the last file added with its path */
+        u32 lo = 0;
+        u32 hi = n;
+        while (lo < hi) {
+            u32 mid = lo + (hi - lo) / 2;
+            if (star_strcmp(names[mid].path, fh->path) <= 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if (lo > 0 && names[lo - 1].idx > i
+                && star_strcmp(names[lo - 1].path, fh->path) == 0)
+            fh->flags |= STAR_F_DELETED;
+    }
+
+    free(names);
+    return true;
 }
 
-bool star_write_fheaders (const struct STAR * self, Stream * out)
+bool star_append (struct STAR * self, u32 first, Stream * io)
 {
-    if (self == NULL || out == NULL)
-        return false;
+    bool ret = false;
+    u8 * hdata = NULL;
 
-    bool ret = true;
-    for (u64 i = 0; i < self->header.nfiles && ret; i++)
-        ret = star_write_fheader(self->fheaders + i, out);
+    ifjmp(self == NULL || io == NULL || self->fheaders == NULL, out);
+    ifjmp(!self->appendable || self->header.version < 11, out);
+    ifjmp(first > self->header.nfiles, out);
+
+    /* only files with their own data, not in blocks */
+    for (u64 i = first; i < self->header.nfiles; i++)
+        ifjmp(self->fdata == NULL
+                || self->fdata[i] == NULL
+                || (self->fheaders[i].flags & STAR_F_SOLID)
+                || (self->same != NULL && self->same[i] != i), out);
+
+    /* a path always finds the file last added with it */
+    ifjmp(!_star_supersede(self, first), out);
+
+    /* after the headers being replaced, so that they're there until they are */
+    u64 pos = self->header.hoffset + self->header.hsize;
+    _star_file_offsets(self, first, pos);
+
+    struct STAR tmp = *self;
+    tmp.header.hsize = _star_hsize(self, 11);
+
+    /* one more byte, a raw Stream can't be empty */
+    hdata = calloc(tmp.header.hsize + 1, sizeof(u8));
+    ifjmp(hdata == NULL, out);
+    ifjmp(!_star_map_write(self, hdata), out);
+    tmp.header.hcrc = _star_header_crc(&tmp, 11, hdata);
+
+    ret =  stream_seek(io, pos)
+        && _star_write_fdata(self, first, &pos, io)
+        && _star_write_pad(io, &pos, self->header.hoffset)
+        && star_write_u8_single(hdata, io, tmp.header.hsize)
+        && stream_flush(io)
+        && stream_seek(io, 0)
+        && star_write_header(&tmp, 11, io)
+        && stream_flush(io);
+
+    /* what was left by an append that didn't get this far */
+    if (ret) {
+        stream_truncate(io, self->size);
+        self->header = tmp.header;
+    }
+
+out:
+    free(hdata);
     return ret;
 }
 
-bool star_write_fdata (const struct STAR * self, Stream * out)
+bool star_delete (struct STAR * self, u64 idx)
 {
-    if (self == NULL || out == NULL || self->fheaders == NULL || self->fdata == NULL)
+    if (self == NULL || self->fheaders == NULL || idx >= self->header.nfiles
+            || !self->appendable || self->header.version < 11
+            || (self->fheaders[idx].flags & STAR_F_DELETED))
         return false;
 
-    bool ret = true;
-    for (u64 i = 0; i < self->header.nfiles && ret; i++)
-        ret = star_write_u8_single(self->fdata[i], out,
-                self->fheaders[i].size);
-    return ret;
+    self->fheaders[idx].flags |= STAR_F_DELETED;
+    return true;
 }
 
-bool star_write (const struct STAR * self, Stream * out)
+/**
+ * @brief Add the stored data at @a offset to what `star_compact()` copies
+ * @param copy What's copied, with room for it
+ * @param offset Offset of the data
+ * @param csize Size of the data, as stored; if `0`, it isn't added
+ * @param size Size to align it by, see `struct _star_range`
+ */
+static void _star_compact_add (struct _star_copy * copy, u64 offset, u64 csize, u64 size)
 {
-    if (out == NULL || !star_check_header(self) || !_star_check_ptrs(self))
-        return false;
+    if (csize == 0)
+        return;
 
-    return star_write_header(self,   out)
-        && star_write_fheaders(self, out)
-        && star_write_fdata(self,    out);
+    struct _star_range * r = copy->ranges + copy->n++;
+    r->from = offset;
+    r->to = 0;
+    r->csize = csize;
+    r->size = size;
 }
 
-/***********************************************************
- * create functions
- **********************************************************/
-struct STAR * star_new (u32 nfiles)
+static int _star_compact_cmp (const void * _l, const void * _r)
 {
-    struct STAR * ret = NULL;
-    struct STAR tmp = {0};
+    const struct _star_range * l = _l;
+    const struct _star_range * r = _r;
 
-    ifjmp(nfiles == 0, out);
+    /* of data at the same offset, the biggest first */
+    return (l->from != r->from) ?
+        (l->from > r->from) - (l->from < r->from) :
+        (l->csize < r->csize) - (l->csize > r->csize) ;
+}
 
-    bool res = ((tmp.fdata = calloc(nfiles, sizeof(u8 *))) != NULL)
-        && ((tmp.fheaders = calloc(nfiles, sizeof(struct StarFileHeader))) != NULL)
-        && ((ret = malloc(sizeof(struct STAR))) != NULL);
+/**
+ * @brief Find where the data at @a offset is copied to
+ * @param copy What's copied, in order
+ * @param offset Offset of the data in the STAR it's copied from
+ * @param start Where the data copied starts, for empty data before it
+ * @returns Where the data goes, or, if it's empty, where the data
+ *     before it ends
+ */
+static u64 _star_compact_to (const struct _star_copy * copy, u64 offset, u64 start)
+{
+    u64 lo = 0;
+    u64 hi = copy->n;
+    while (lo < hi) {
+        u64 mid = lo + (hi - lo) / 2;
+        if (copy->ranges[mid].from < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    ifjmp(!res, ko);
+    if (lo < copy->n && copy->ranges[lo].from == offset)
+        return copy->ranges[lo].to;
 
-    memcpy(&tmp.header.magic, STAR_MAGIC, sizeof(STAR_MAGIC));
-    tmp.header.nfiles = nfiles;
+    return (lo > 0) ?
+        copy->ranges[lo - 1].to + copy->ranges[lo - 1].csize :
+        start ;
+}
 
-    *ret = tmp;
+/**
+ * @brief Find the stored data of the files and solid blocks of @a self,
+ *     in order, each piece once
+ * @param self The STAR
+ * @param copy Where to put it, with room for it
+ * @returns `true` if it was found, `false` if pieces overlap
+ */
+static bool _star_compact_ranges (const struct STAR * self, struct _star_copy * copy)
+{
+    copy->n = 0;
 
-out:
-    return ret;
+    for (u32 b = 0; b < self->header.nblocks; b++)
+        _star_compact_add(copy, self->blocks[b].offset, self->blocks[b].csize, self->blocks[b].size);
 
-ko:
-    if (ret != NULL) {
-        free(ret);
-        ret = NULL;
+    for (u32 i = 0; i < self->header.nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+
+        /* only its first own chunk, where the file is, is aligned */
+        if (fh->flags & STAR_F_CHUNKED) {
+            for (u32 c = 0; c < fh->nchunks; c++)
+                _star_compact_add(copy, fh->chunks[c].offset, fh->chunks[c].csize,
+                        (fh->chunks[c].offset == fh->offset) ? fh->size : 0);
+        } else if (!(fh->flags & STAR_F_SOLID)) {
+            _star_compact_add(copy, fh->offset, fh->csize, fh->size);
+        }
     }
 
-    if (tmp.fdata != NULL)
-        free(tmp.fdata);
+    qsort(copy->ranges, copy->n, sizeof(struct _star_range), _star_compact_cmp);
 
-    if (tmp.fheaders != NULL)
-        free(tmp.fheaders);
+    u64 k = 0;
+    for (u64 i = 0; i < copy->n; i++) {
+        const struct _star_range * r = copy->ranges + i;
+        struct _star_range * prev = (k > 0) ? copy->ranges + k - 1 : NULL;
 
-    goto out;
+        /* shared data is copied once, and never overlaps otherwise */
+        if (prev != NULL && r->from == prev->from) {
+            if (r->size > prev->size)
+                prev->size = r->size;
+            continue;
+        }
+        if (prev != NULL && r->from < prev->from + prev->csize)
+            return false;
+
+        copy->ranges[k++] = *r;
+    }
+    copy->n = k;
+
+    return true;
 }
 
-bool star_add_file (struct STAR * self, u32 idx, const u8 * path, u32 size, Stream * in)
+/**
+ * @brief Tell how the data in @a copy was aligned, for a STAR that
+ *     doesn't say (before version 11)
+ * @param self The STAR, whose `align` is set, and `align_min`, unless
+ *     it already was
+ * @param copy The stored data of all of its files, deleted or not
+ *
+ * Data is only ever padded to be aligned, so the boundary is what the
+ * offsets of all padded data have in common, and the smallest aligned
+ * size is just above that of the biggest data that isn't aligned.
+ */
+static void _star_compact_align (struct STAR * self, const struct _star_copy * copy)
 {
-    bool ret = false;
-    u8 * fdata = NULL;
-    struct StarFileHeader fheader = {0};
+    u64 align = 0;
+    for (u64 i = 1; i < copy->n; i++) {
+        const struct _star_range * prev = copy->ranges + i - 1;
+        u64 from = copy->ranges[i].from;
 
-    ifjmp(self == NULL, out);
-    ifjmp(in == NULL, out);
-    ifjmp(path == NULL, out);
-    ifjmp(idx >= self->header.nfiles, out);
+        if (from == prev->from + prev->csize)
+            continue;
 
-    { /* file data */
-        fdata = malloc(size);
-        ifjmp(fdata == NULL, out);
+        /* greatest common divisor */
+        for (u64 a = from; a != 0; ) {
+            u64 t = align % a;
+            align = a;
+            a = t;
+        }
+    }
 
-        u64 r = stream_read(in, fdata, size, 1);
-        ifjmp(r != 1, ko);
+    u64 align_min = 0;
+    for (u64 i = 0; i < copy->n && align > 1; i++) {
+        const struct _star_range * r = copy->ranges + i;
+        if (r->size > 0 && r->from % align != 0 && r->size >= align_min)
+            align_min = r->size + 1;
     }
 
-    { /* path */
-        fheader.path = (void *) strdup((void *) path);
-        ifjmp(fheader.path == NULL, ko);
-        fheader.path_len = strlen((void *) fheader.path) + 1;
+    self->align = align;
+    if (self->align_min == 0)
+        self->align_min = align_min;
+}
+
+bool star_compact (struct STAR * self, Stream * in, Stream * out)
+{
+    bool ret = false;
+    u32 * blocks = NULL;
+    struct _star_copy copy = { .in = in };
+
+    /* only what was read, with no data in memory */
+    ifjmp(self == NULL || in == NULL || out == NULL || self->fheaders == NULL, out);
+    ifjmp(self->fdata != NULL || self->bdata != NULL, out);
+
+    /* the stored data of every file, and then of those left */
+    u64 n = self->header.nblocks;
+    for (u32 i = 0; i < self->header.nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+        n += (fh->flags & STAR_F_CHUNKED) ?
+            fh->nchunks :
+            !(fh->flags & STAR_F_SOLID) ;
     }
 
-    fheader.size = size;
+    copy.ranges = malloc((size_t) (n + 1) * sizeof(struct _star_range));
+    ifjmp(copy.ranges == NULL, out);
 
-    self->fdata[idx] = fdata;
-    self->fheaders[idx] = fheader;
+    /* unless asked otherwise, aligned as it was */
+    if (self->align == 0 && self->header.version < 11) {
+        ifjmp(!_star_compact_ranges(self, &copy), out);
+        _star_compact_align(self, &copy);
+    }
 
-    ret = true;
+    /* the files left, in the order they were */
+    u32 nfiles = 0;
+    for (u32 i = 0; i < self->header.nfiles; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
 
-out:
-    return ret;
+        if (fh->flags & STAR_F_DELETED) {
+            free(fh->path);
+            free(fh->chunks);
+        } else {
+            self->fheaders[nfiles++] = *fh;
+        }
+    }
+    self->header.nfiles = nfiles;
+    ifjmp(nfiles == 0, out);
 
-ko:
-    if (fdata != NULL)
-        free(fdata);
+    /* and the blocks left, each's new index plus one, `0` if it isn't */
+    blocks = calloc((size_t) self->header.nblocks + 1, sizeof(u32));
+    ifjmp(blocks == NULL, out);
 
-    if (fheader.path != NULL)
-        free(fheader.path);
+    for (u32 i = 0; i < nfiles; i++) {
+        const struct StarFileHeader * fh = self->fheaders + i;
+        if (fh->flags & STAR_F_SOLID) {
+            ifjmp(fh->block >= self->header.nblocks, out);
+            blocks[fh->block] = 1;
+        }
+    }
 
-    goto out;
-}
+    u32 nblocks = 0;
+    for (u32 b = 0; b < self->header.nblocks; b++) {
+        if (blocks[b] != 0) {
+            self->blocks[nblocks] = self->blocks[b];
+            blocks[b] = ++nblocks;
+        }
+    }
+    self->header.nblocks = nblocks;
+    self->bcached = 0;
 
-/*
- * assume self is a complete `struct STAR`, ready to
- * write, except for the file offsets
- */
-bool star_file_offsets (struct STAR * self)
-{
-    if (self == NULL)
-        return false;
+    ifjmp(!_star_compact_ranges(self, &copy), out);
 
-    u64 offset = 0;
+    /* packed, as star_file_offsets() would */
+    u8 version = _star_version(self);
+    u64 start = _star_fdata_offset(self, version);
+    u64 offset = start;
+    self->padding = 0;
+    for (u64 i = 0; i < copy.n; i++) {
+        offset = _star_align(self, offset, copy.ranges[i].size);
+        copy.ranges[i].to = offset;
+        offset += copy.ranges[i].csize;
+    }
 
-    /*
-     * offset from the beggining of the STAR file to the
-     * beggining of stored files' data
-     */
-    {
-        offset += sizeof(struct StarHeader);
-        offset += self->header.nfiles * sizeof(struct StarFileHeader);
+    for (u32 b = 0; b < nblocks; b++)
+        self->blocks[b].offset = _star_compact_to(&copy, self->blocks[b].offset, start);
+
+    /* files in blocks are where they were in them */
+    for (u32 i = 0; i < nfiles; i++) {
+        struct StarFileHeader * fh = self->fheaders + i;
 
-        /* add path length */
-        for (u64 i = 0; i < self->header.nfiles; i++)
-            offset += self->fheaders[i].path_len;
+        if (fh->flags & STAR_F_SOLID) {
+            fh->block = blocks[fh->block] - 1;
+            continue;
+        }
 
-        /* subtract size of pointer to path */
-        offset -= self->header.nfiles * sizeof(self->fheaders->path);
+        fh->offset = _star_compact_to(&copy, fh->offset, start);
+        for (u32 c = 0; (fh->flags & STAR_F_CHUNKED) && c < fh->nchunks; c++)
+            fh->chunks[c].offset = _star_compact_to(&copy, fh->chunks[c].offset, start);
     }
 
-    /* beggining of fdata */
-    self->fheaders[0].offset = offset;
-    for (u64 i = 0; i < self->header.nfiles - 1; i++)
-        self->fheaders[i + 1].offset = self->fheaders[i].offset + self->fheaders[i].size;
+    _star_end_offsets(self, offset);
 
-    return true;
+    ret = _star_write(self, &copy, out);
+
+out:
+    free(copy.ranges);
+    free(blocks);
+    return ret;
 }
 
 /***********************************************************
@@ -611,11 +4957,14 @@ u64 star_search (const struct STAR * self, const u8 * fname)
 
     size_t fl = strlen((void *) fname);
 
-    for (ret = 0; ret < self->header.nfiles && !match; ret++) {
-        u8 n = self->fheaders[ret].path_len - 1;
+    for (ret = 0; ret < self->header.nfiles; ret++) {
+        u16 n = (u16) (self->fheaders[ret].path_len - 1);
         match = (n == fl)
+            && !(self->fheaders[ret].flags & STAR_F_DELETED)
             &&  (strncmp((void *) fname,
                         (void *) self->fheaders[ret].path, n) == 0);
+        if (match)
+            break;
     }
 
 out:
@@ -7,6 +7,8 @@
  *
  * <stdint.h>
  *  UINT64_MAX
+ *  uint16_t
+ *  uint32_t
  *  uint64_t
  *  uint8_t
  */
@@ -40,11 +42,44 @@ typedef uint64_t u64;
  */
 typedef uint32_t u32;
 
+/**
+ * @brief An 16-bit wide unsigned integer
+ */
+typedef uint16_t u16;
+
 /**
  * @brief An 8-bit wide unsigned integer
  */
 typedef uint8_t  u8;
 
+/**
+ * @brief Latest version of the STAR format
+ *
+ * Version 1 has no version field; later versions write `0` where
+ * version 1 has the number of files, followed by the version and then
+ * the number of files. Version 8 only widens the sizes of files, and
+ * their paths' lengths, see `struct StarFileHeader`.
+ *
+ * Version 9 is the same as version 8, but its headers are laid out to
+ * be used in place (see `star_map()`): after the STAR header, padded to
+ * 8 bytes, come a `struct StarMapDir`, the `struct StarRecord` of each
+ * file, the index of each file in order of path (see `star_strcmp()`),
+ * padded to 8 bytes, the `struct StarChunkRecord` of every chunk of
+ * every file, the `struct StarBlockRecord` of each solid block, the
+ * dictionary, padded to 8 bytes, and the paths, each `NULL` terminated,
+ * padded to 8 bytes. Everything is little-endian.
+ *
+ * Version 10 is laid out as version 9, and may have `STAR_F_SPARSE`
+ * files.
+ *
+ * Version 11 is the same as version 10, but its headers come after the
+ * files' data, at `hoffset`, so that files can be appended without
+ * rewriting it (see `star_append()`); the headers an append replaces
+ * are left where they were, unused. Its files may be `STAR_F_DELETED`,
+ * and its STAR header has the alignment its data was laid out with.
+ */
+#define STAR_VERSION 11
+
 /**
  * @brief A STAR header
  */
@@ -53,20 +88,266 @@ struct StarHeader {
     u8 magic[4];
     /** Number of files the STAR archive contains */
     u32 nfiles;
+    /** Version of the format (not written as is in version 1) */
+    u8 version;
+    /** Number of solid blocks (since version 3) */
+    u32 nblocks;
+    /** Size of the dictionary, in bytes (since version 4) */
+    u32 dsize;
+    /** Offset from the beggining of the STAR to the headers after the
+     *  STAR header, a multiple of 8 (since version 11; right after the
+     *  STAR header before) */
+    u64 hoffset;
+    /** Boundary the data of files and solid blocks was aligned to, in
+     *  bytes, and smallest file or block that was, kept for the data
+     *  appended and compacted later (since version 11; see `align` and
+     *  `align_min` of `struct STAR`) */
+    u64 align;
+    u64 align_min;
+    /** Size of the block table, dictionary and file headers, in bytes
+     *  (since version 6) */
+    u64 hsize;
+    /** CRC32C of the STAR header, up to this field, and of the `hsize`
+     *  bytes after it (since version 6) */
+    u32 hcrc;
+};
+
+/**
+ * @brief Flags of an archived file (since version 2)
+ */
+enum StarFileFlags {
+    /** The file's data is split in chunks, see `struct StarChunk` */
+    STAR_F_CHUNKED = 1 << 0,
+    /** The file's data is in a solid block, see `struct StarBlock`
+     *  (since version 3) */
+    STAR_F_SOLID = 1 << 1,
+    /** The file's data didn't compress, or looked like it wouldn't,
+     *  and is stored as is; only informative, see `star_compress()` */
+    STAR_F_INCOMPRESSIBLE = 1 << 2,
+    /** The file header has the CRC32C of the file's data (since version 5) */
+    STAR_F_CHECKSUM = 1 << 3,
+    /** Each chunk has the CRC32C of its data, and with `STAR_F_CHECKSUM`
+     *  the file's CRC32C is theirs combined; only with `STAR_F_CHUNKED`
+     *  (since version 7) */
+    STAR_F_CHUNK_CHECKSUM = 1 << 4,
+    /** The file has holes, and its data is only what isn't in them: a
+     *  `struct StarSparse`, a `struct StarRun` for each run of data, in
+     *  order, and the data of the runs, one after the other; everything
+     *  else is zeros (since version 10) */
+    STAR_F_SPARSE = 1 << 5,
+    /** The file was deleted, but its data is still there, until the
+     *  STAR is compacted (see `star_delete()` and `star_compact()`)
+     *  (since version 11) */
+    STAR_F_DELETED = 1 << 6,
+};
+
+/**
+ * @brief Codecs the data of an archived file may be stored with (since
+ *     version 2)
+ *
+ * With a codec, the file's data (or each of its chunks) is compressed
+ * on its own; data that doesn't get any smaller is stored as is, and
+ * its stored size is its size.
+ */
+enum StarCodec {
+    /** Stored as is */
+    STAR_CODEC_NONE = 0,
+    /** Compressed with the codec of `lz.h` */
+    STAR_CODEC_LZ = 1,
+    /** Compressed with the codec of `lz.h`, against the STAR's
+     *  dictionary (since version 4) */
+    STAR_CODEC_LZ_DICT = 2,
+};
+
+/**
+ * @brief A solid block: the data of small files, one after the other,
+ *     compressed together (since version 3)
+ */
+struct StarBlock {
+    /** Offset from the beggining of the STAR to the beggining of the block */
+    u64 offset;
+    /** Size of the block, in bytes */
+    u32 size;
+    /** Size of the block as stored, in bytes */
+    u32 csize;
+    /** Codec of the block, see `enum StarCodec` */
+    u8 codec;
+};
+
+/**
+ * @brief A chunk of an archived file's data
+ */
+struct StarChunk {
+    /** Offset from the beggining of the STAR to the beggining of the chunk */
+    u64 offset;
+    /** Offset from the beggining of the file's data to the beggining of
+     *  the chunk (not stored, the sum of the sizes of the chunks before it) */
+    u64 start;
+    /** Size of the chunk, in bytes */
+    u32 size;
+    /** Size of the chunk as stored, in bytes (`size`, if the file has
+     *  no codec) */
+    u32 csize;
+    /** CRC32C of the chunk's data, if the file is `STAR_F_CHUNK_CHECKSUM` */
+    u32 crc;
+    /** The chunk whose data this chunk shares, `NULL` if it has its own */
+    const struct StarChunk * same;
 };
 
 /**
  * @brief Header of a file archived in a STAR archive
  */
 struct StarFileHeader {
-    /** Size of the file, in bytes */
-    u32 size;
-    /** Offset from the beggining of the STAR to the beggining of the file */
+    /** Size of the file, in bytes (stored in 32 bits before version 8) */
+    u64 size;
+    /** Offset from the beggining of the STAR to the beggining of the
+     *  file, or from the beggining of its block's data, if `STAR_F_SOLID` */
     u64 offset;
-    /** Number of bytes of the path/filename, including terminating `NULL` byte */
-    u8 path_len;
+    /** Number of bytes of the path/filename, including terminating
+     *  `NULL` byte (stored in 8 bits before version 8) */
+    u16 path_len;
     /** Path/filename of the file (no encoding assumed, just a sequence of bytes) */
     u8 * path;
+    /** Flags of the file, see `enum StarFileFlags` */
+    u8 flags;
+    /** Codec of the file's data, see `enum StarCodec` */
+    u8 codec;
+    /** Size of the file's data as stored, in bytes, if not
+     *  `STAR_F_CHUNKED` (`size`, if it has no codec; stored in 32
+     *  bits before version 8) */
+    u64 csize;
+    /** Index of the solid block with the file's data, if `STAR_F_SOLID` */
+    u32 block;
+    /** CRC32C of the file's data, if `STAR_F_CHECKSUM` */
+    u32 crc;
+    /** Number of chunks, if `STAR_F_CHUNKED` */
+    u32 nchunks;
+    /** The chunks, in order, if `STAR_F_CHUNKED`; the file's data is
+     *  their concatenation, and `offset` is where its own chunks start */
+    struct StarChunk * chunks;
+};
+
+/**
+ * @brief How the data of a `STAR_F_SPARSE` file starts, little-endian
+ */
+struct StarSparse {
+    /** Size of the file, holes included, in bytes */
+    u64 size;
+    /** Number of `struct StarRun`s after it */
+    u64 nruns;
+};
+
+/**
+ * @brief A run of data of a `STAR_F_SPARSE` file, little-endian
+ */
+struct StarRun {
+    /** Offset of the run in the file, after the run before it */
+    u64 offset;
+    /** Size of the run, in bytes, more than `0` */
+    u64 size;
+};
+
+/**
+ * @brief What a STAR of version 9 has, that isn't in its STAR header
+ */
+struct StarMapDir {
+    /** Number of `struct StarChunkRecord`s */
+    u64 nchunks;
+    /** Size of all the paths, in bytes */
+    u64 ssize;
+};
+
+/**
+ * @brief A `struct StarFileHeader`, as it's stored in a STAR of version 9
+ */
+struct StarRecord {
+    /** Size of the file, in bytes */
+    u64 size;
+    /** Offset of the file's data, as in `struct StarFileHeader` */
+    u64 offset;
+    /** Size of the file's data as stored, in bytes, as in `struct StarFileHeader` */
+    u64 csize;
+    /** Index of the file's first `struct StarChunkRecord`, if `STAR_F_CHUNKED` */
+    u64 chunk;
+    /** Offset of the file's path from the beggining of the paths */
+    u64 path;
+    /** Number of chunks, if `STAR_F_CHUNKED` */
+    u32 nchunks;
+    /** Index of the solid block with the file's data, if `STAR_F_SOLID` */
+    u32 block;
+    /** CRC32C of the file's data, if `STAR_F_CHECKSUM` */
+    u32 crc;
+    /** Number of bytes of the path, including terminating `NULL` byte */
+    u16 path_len;
+    /** Flags of the file, see `enum StarFileFlags` */
+    u8 flags;
+    /** Codec of the file's data, see `enum StarCodec` */
+    u8 codec;
+};
+
+/**
+ * @brief A `struct StarChunk`, as it's stored in a STAR of version 9
+ */
+struct StarChunkRecord {
+    /** Offset from the beggining of the STAR to the beggining of the chunk */
+    u64 offset;
+    /** Size of the chunk, in bytes */
+    u32 size;
+    /** Size of the chunk as stored, in bytes */
+    u32 csize;
+    /** CRC32C of the chunk's data, if the file is `STAR_F_CHUNK_CHECKSUM` */
+    u32 crc;
+    /** Always `0` */
+    u32 reserved;
+};
+
+/**
+ * @brief A `struct StarBlock`, as it's stored in a STAR of version 9
+ */
+struct StarBlockRecord {
+    /** Offset from the beggining of the STAR to the beggining of the block */
+    u64 offset;
+    /** Size of the block, in bytes */
+    u32 size;
+    /** Size of the block as stored, in bytes */
+    u32 csize;
+    /** Codec of the block, see `enum StarCodec` */
+    u8 codec;
+    /** Always `0` */
+    u8 reserved[7];
+};
+
+/**
+ * @brief A STAR of version 9, used in place, see `star_map()`
+ *
+ * Nothing but the STAR header is checked up front; each record is
+ * checked as it's used. The records are little-endian; the `star_map`
+ * functions read them a byte at a time, so only on little-endian hosts
+ * can they be read as they are.
+ */
+struct StarMap {
+    /** The STAR header */
+    struct StarHeader header;
+    /** The whole STAR */
+    const u8 * data;
+    /** Size of the whole STAR, in bytes */
+    u64 size;
+    /** The record of each file */
+    const struct StarRecord * records;
+    /** The index of each file, in order of path */
+    const u32 * names;
+    /** The records of the chunks */
+    const struct StarChunkRecord * chunks;
+    /** Number of elements of `chunks` */
+    u64 nchunks;
+    /** The records of the solid blocks */
+    const struct StarBlockRecord * blocks;
+    /** The dictionary, `header.dsize` bytes */
+    const u8 * dict;
+    /** The paths */
+    const u8 * strings;
+    /** Size of `strings`, in bytes */
+    u64 ssize;
 };
 
 /**
@@ -79,6 +360,42 @@ struct STAR {
     struct StarFileHeader * fheaders;
     /** File data */
     u8 ** fdata;
+    /** For each file, the index of the first file with the same data,
+     *  whose data it shares; `NULL` if no files share data (only used
+     *  when creating a STAR, see `star_dedup()`) */
+    u32 * same;
+    /** For each file, its data as stored: compressed, and only its own
+     *  chunks, if `STAR_F_CHUNKED`; `NULL` if it has no codec (only
+     *  used when creating a STAR, see `star_compress()`) */
+    u8 ** cdata;
+    /** The solid blocks, see `star_solid()` */
+    struct StarBlock * blocks;
+    /** For each solid block, its data as stored */
+    u8 ** bdata;
+    /** The dictionary, see `star_train()`; `NULL` if none */
+    u8 * dict;
+    /** Data of the last solid block decoded to extract a file */
+    u8 * bcache;
+    /** Index of the block in `bcache`, plus one; `0` if none */
+    u64 bcached;
+    /** Write it with the headers laid out to be used in place, as
+     *  version 9 (see `star_map()`); a STAR with `STAR_F_SPARSE` files
+     *  always is, as version 10 */
+    bool mappable;
+    /** Write it with the headers after the files' data, as version 11,
+     *  so that files can be appended to it (see `star_append()`) */
+    bool appendable;
+    /** Boundary to align the data of files and solid blocks to, in
+     *  bytes; `0` or `1` for none (only used when creating a STAR, see
+     *  `star_file_offsets()`) */
+    u64 align;
+    /** Smallest file or solid block whose data is aligned, in bytes */
+    u64 align_min;
+    /** Bytes of padding `star_file_offsets()` put before data to align it */
+    u64 padding;
+    /** Size of the whole STAR, as `star_write()` writes it, set by
+     *  `star_file_offsets()` */
+    u64 size;
 };
 
 /***********************************************************
@@ -93,13 +410,24 @@ struct STAR {
 bool star_check_header (const struct STAR * self);
 
 /**
- * @brief Fake natural sorting
+ * @brief Natural order comparison: digit runs compare as numbers
+ *     (`pre2 < pre10`), everything else byte by byte
  * @param l String to compare
  * @param r String to compare
  * @returns Similar to `strcmp()`
  */
 int star_strcmp (const void * l, const void * r);
 
+/**
+ * @brief Sort @a strs in the order of `star_strcmp()`
+ * @param strs The strings to sort
+ * @param n Number of strings in @a strs
+ *
+ * Each string is scanned only once, to make a key comparable with
+ * `memcmp()`; many strings are radix sorted by those keys.
+ */
+void star_sort (char ** strs, size_t n);
+
 /**
  * @brief Free @a self
  * @param self The STAR
@@ -126,13 +454,30 @@ bool star_read_header (struct STAR * self, Stream * in);
  */
 u64 star_read_fdata (struct STAR * self, Stream * in);
 
+/**
+ * @brief Read the solid block table from @a in to @a self
+ * @param self The STAR, with the STAR header
+ * @param in A Stream opened with the "rb" mode and positioned right after the STAR header
+ * @returns `true` if it successfully read the block table, `false` otherwise
+ */
+bool star_read_blocks (struct STAR * self, Stream * in);
+
+/**
+ * @brief Read the dictionary from @a in to @a self
+ * @param self The STAR, with the STAR header
+ * @param in A Stream opened with the "rb" mode and positioned right after the solid block table
+ * @returns `true` if it successfully read the dictionary, `false` otherwise
+ */
+bool star_read_dict (struct STAR * self, Stream * in);
+
 /**
  * @brief Read one archived file header from @a in to @a fheader
  * @param fheader STAR file header to read to
+ * @param version Version of the STAR
  * @param in A Stream opened with the "rb" mode and positioned at the beggining of the first archived file header
  * @returns `true` if it successfully read the file header, `false` otherwise
  */
-bool star_read_fheader (struct StarFileHeader * fheader, Stream * in);
+bool star_read_fheader (struct StarFileHeader * fheader, u8 version, Stream * in);
 
 /**
  * @brief Read archived file headers from @a in to @a self
@@ -145,14 +490,188 @@ u64 star_read_fheaders (struct STAR * self, Stream * in);
 /**
  * @brief Read a STAR from @a in
  * @param in A Stream opened with the "rb" mode and positioned at the beggining of a STAR header
- * @returns A pointer to a STAR, or `NULL` if an error occurred
+ * @returns A pointer to a STAR, or `NULL` if an error occurred, or the
+ *     data of some file doesn't match its checksum
  */
 struct STAR * star_read (Stream * in);
 
+/**
+ * @brief Read a STAR's header and file headers from @a in, but none of
+ *     the files' data
+ * @param in A Stream opened with the "rb" mode and positioned at the beggining of a STAR header
+ * @returns A pointer to a STAR without file data, or `NULL` if an error occurred
+ *
+ * Since version 6, everything up to the files' data is read at once
+ * and checked against the header's checksum before any of it is
+ * trusted, so a damaged header fails here, and not on some huge
+ * allocation later on.
+ *
+ * Solid blocks are read and decoded only when a file in them is
+ * extracted, and the last one is kept, for its neighbours.
+ *
+ * Since version 11, `align` and `align_min` are set as the STAR header
+ * says, so that what's appended (see `star_append()`) or compacted (see
+ * `star_compact()`) is aligned as the rest of the data.
+ */
+struct STAR * star_read_headers (Stream * in);
+
+/**
+ * @brief Read the data of the archived file @a idx from @a in, and
+ *     write it to @a out, a piece at a time
+ * @param self The STAR, with every file header (see `star_read_headers()`)
+ * @param idx Index of the file
+ * @param in A seekable Stream opened with the "rb" mode, with the whole STAR
+ * @param out A Stream opened with the "wb" mode
+ * @returns `true` if the file was successfully extracted, `false` if an
+ *     error occurred, or its data doesn't match its checksum
+ *
+ * The checksum, if the file has one, is checked as the data is written,
+ * so when it doesn't match, @a out already has the corrupt data.
+ *
+ * Room for the whole file is allocated in @a out up front, if it can be
+ * (see `stream_reserve()`).
+ *
+ * The holes of a `STAR_F_SPARSE` file are left as holes, seeking past
+ * them in @a out (and setting its size with `stream_truncate()`), if it
+ * can; if not, they're written as zeros.
+ */
+bool star_extract (struct STAR * self, u64 idx, Stream * in, Stream * out);
+
+/**
+ * @brief Tell @a in the stored data of the archived file @a idx is going
+ *     to be read soon (see `stream_willneed()`)
+ * @param self The STAR, with every file header (see `star_read_headers()`)
+ * @param idx Index of the file
+ * @param in A Stream with the whole STAR
+ * @returns `true` if @a in was told, `false` otherwise
+ *
+ * Meant for extracting files out of order: while one is extracted, the
+ * page cache can already be reading the next one.
+ */
+bool star_prefetch (const struct STAR * self, u64 idx, Stream * in);
+
+/**
+ * @brief Read @a size bytes at @a offset of the data of the archived
+ *     file @a idx from @a in to @a out
+ * @param self The STAR, with every file header (see `star_read_headers()`)
+ * @param idx Index of the file
+ * @param offset Offset in the file's data
+ * @param size Number of bytes to read
+ * @param in A seekable Stream opened with the "rb" mode, with the whole STAR
+ * @param out Where to read to, with room for @a size bytes
+ * @returns `true` if the range was read, `false` if it's past the end of
+ *     the file, an error occurred, or a chunk it touches doesn't match
+ *     its checksum
+ *
+ * The file's checksum is of all its data, so it isn't checked; with
+ * `STAR_F_CHUNK_CHECKSUM`, each chunk the range touches is read whole,
+ * and checked.
+ *
+ * Only the chunks (or blocks, see `star_compress()`) the range touches
+ * are read and decoded; they're found by a binary search of the file's
+ * chunks, so reading a small range of a big file is cheap.
+ *
+ * The data of a `STAR_F_SPARSE` file is as it's stored, see
+ * `STAR_F_SPARSE`.
+ */
+bool star_read_range (struct STAR * self, u64 idx, u64 offset, u64 size, Stream * in, u8 * out);
+
+/**
+ * @brief Check that @a self, as stored in @a in, is sound
+ * @param self The STAR, with every file header (see `star_read_headers()`)
+ * @param in A Stream opened with the "rb" mode, with the whole STAR;
+ *     only read with `stream_pread()`, so it's left where it is
+ * @param size Size of the whole STAR, in bytes
+ * @param nthreads Number of threads to check files with
+ * @param bad For each file, set to whether it doesn't check out, or `NULL`
+ * @returns Number of files that don't check out, or `STAR_DNF` if an
+ *     error occurred
+ *
+ * Every file's data has to be inside the STAR, after the headers, and
+ * not overlap anything else, unless it's the very same data, shared
+ * (see `star_dedup()` and `star_chunk()`); it has to decode to the
+ * right size, and match the file's checksum, if it has one. The files
+ * are checked on many threads, each reading its files' data at their
+ * offsets; so with enough threads, how fast it goes is how fast the
+ * STAR can be read. Files with `STAR_F_CHUNK_CHECKSUM` are checked a
+ * chunk at a time, so even a single big file is checked on many threads.
+ */
+u64 star_verify (const struct STAR * self, Stream * in, u64 size, unsigned nthreads, bool * bad);
+
+/***********************************************************
+ * map functions
+ **********************************************************/
+
+/**
+ * @brief Use @a data, a whole STAR of version 9, in place
+ * @param self The StarMap
+ * @param data The STAR, aligned to 8 bytes (as by `mmap()`), that
+ *     has to outlive @a self
+ * @param size Size of @a data, in bytes
+ * @returns `true` if @a data is a STAR of version 9, and its sections
+ *     fit in it, `false` otherwise
+ *
+ * Only the STAR header is read; no file header is parsed until it's
+ * used, so opening a STAR with millions of files is as fast as opening
+ * one with a single file. The headers aren't checked against their
+ * checksum, as that would read them all; `star_read_headers()` does.
+ */
+bool star_map (struct StarMap * self, const void * data, u64 size);
+
+/**
+ * @brief Get the path of the file @a idx of @a self
+ * @param self The StarMap
+ * @param idx Index of the file
+ * @returns The path, or `NULL` if there's no such file, or its path
+ *     isn't within the paths, `NULL` terminated
+ */
+const u8 * star_map_path (const struct StarMap * self, u64 idx);
+
+/**
+ * @brief Binary search for a file named @a fname in @a self, with the
+ *     index of files in order of path
+ * @param self The StarMap
+ * @param fname The filename to search
+ * @returns The index of the first file that wasn't deleted (see
+ *     `STAR_F_DELETED`), or `STAR_DNF` if there's no such file
+ */
+u64 star_map_search (const struct StarMap * self, const u8 * fname);
+
+/**
+ * @brief Get the file header of the file @a idx of @a self
+ * @param self The StarMap
+ * @param idx Index of the file
+ * @param fheader Where to put the file header, whose `path` and
+ *     `chunks` have to be `free()`d
+ * @returns `true` if the file's record checks out, `false` otherwise
+ */
+bool star_map_fheader (const struct StarMap * self, u64 idx, struct StarFileHeader * fheader);
+
+/**
+ * @brief Extract the file @a idx of @a self to @a out, as
+ *     `star_extract()`
+ * @param self The StarMap
+ * @param idx Index of the file
+ * @param out A Stream opened with the "wb" mode
+ * @returns `true` if the file was successfully extracted, `false` if an
+ *     error occurred, its record doesn't check out, or its data doesn't
+ *     match its checksum
+ */
+bool star_map_extract (const struct StarMap * self, u64 idx, Stream * out);
+
 /***********************************************************
  * write functions
  **********************************************************/
 
+/**
+ * @brief Write the STAR header of @a self to @a out
+ * @param self The STAR
+ * @param version Version of the format to write
+ * @param out A Stream opened with the "wb" mode
+ * @returns `true` if the header was successfully written, `false` otherwise
+ */
+bool star_write_header (const struct STAR * self, u8 version, Stream * out);
+
 /**
  * @brief Write @a self to @a out
  * @param self The STAR
@@ -161,6 +680,63 @@ struct STAR * star_read (Stream * in);
  */
 bool star_write (const struct STAR * self, Stream * out);
 
+/**
+ * @brief Write the files @a first and after of @a self to the end of
+ *     @a io, and then the headers of all of its files
+ * @param self The STAR, read from @a io (see `star_read_headers()`),
+ *     with files added after it was (see `star_extend()`)
+ * @param first Index of the first file added; the number of files, if
+ *     none were, to write only the headers (e.g. after `star_delete()`)
+ * @param io A seekable Stream opened with the "r+b" mode, with the
+ *     whole STAR, of version 11
+ * @returns `true` if the files were appended, `false` if an error
+ *     occurred, or an added file is `STAR_F_SOLID`
+ *
+ * Only the added files' data, the headers and the STAR header are
+ * written; the files already in @a io are left as they are. The STAR
+ * header is written last, so until it is, @a io is still the STAR it
+ * was. The added files are aligned as asked in @a self, which is as
+ * the files already in it were, when read.
+ *
+ * Files with the same path as a file added after them are marked
+ * `STAR_F_DELETED`, so that a path finds only the file last added with
+ * it, as searched for or extracted.
+ */
+bool star_append (struct STAR * self, u32 first, Stream * io);
+
+/**
+ * @brief Mark the file @a idx of @a self deleted
+ * @param self The STAR, of version 11 (see `star_read_headers()`)
+ * @param idx Index of the file
+ * @returns `true` if the file was marked, `false` if there's no such
+ *     file, or it already was
+ *
+ * Only @a self is changed; the deletion is written with `star_append()`,
+ * with no files added, and the file's data is there until
+ * `star_compact()`.
+ */
+bool star_delete (struct STAR * self, u64 idx);
+
+/**
+ * @brief Write @a self to @a out without its `STAR_F_DELETED` files,
+ *     copying the data of the others from @a in as it's stored
+ * @param self The STAR, read from @a in (see `star_read_headers()`),
+ *     with the files' new offsets when done
+ * @param in A Stream opened with the "rb" mode, with the whole STAR
+ * @param out A Stream opened with the "wb" mode
+ * @returns `true` if @a self was written, `false` if an error occurred,
+ *     or every file was deleted
+ *
+ * Data is copied with `stream_copy()`, in the order it's in @a in, and
+ * data shared by many files (or chunks, see `star_dedup()` and
+ * `star_chunk()`) only once. Solid blocks with no files left are left
+ * out; the others are copied whole. Data is aligned as asked in @a self
+ * (see `star_file_offsets()`), or, if it isn't (`align` is `0`), as it
+ * was: as the STAR header says, since version 11 (see
+ * `star_read_headers()`), or as the offsets of the data tell, before.
+ */
+bool star_compact (struct STAR * self, Stream * in, Stream * out);
+
 /***********************************************************
  * create functions
  **********************************************************/
@@ -172,14 +748,136 @@ bool star_write (const struct STAR * self, Stream * out);
  * @param path The filename of the file to add
  * @param size Size of the file, in bytes
  * @param in A Stream opened with the "rb" mode and positioned at the start of the data to be read
- * @returns `true` if the file was successfully added, `false` otherwise
+ * @returns `true` if the file was successfully added, `false` if an
+ *     error occurred, or @a path is too long for `path_len`
+ *
+ * The file's checksum is calculated as it's added.
+ */
+bool star_add_file (struct STAR * self, u32 idx, const u8 * path, u64 size, Stream * in);
+
+/**
+ * @brief Add a file that may have holes to a STAR, reading only its
+ *     runs of data
+ * @param self The STAR
+ * @param idx Index where to add given file
+ * @param path The filename of the file to add
+ * @param size Size of the file, in bytes
+ * @param in A seekable Stream opened with the "rb" mode, with the file
+ * @returns `true` if the file was successfully added, `false` if an
+ *     error occurred, or @a path is too long for `path_len`
+ *
+ * The runs are found with `stream_data()`. If the file has holes big
+ * enough to save some space, it's added as `STAR_F_SPARSE`; if not, or
+ * if they can't be found, it's added as by `star_add_file()`.
+ */
+bool star_add_sparse (struct STAR * self, u32 idx, const u8 * path, u64 size, Stream * in);
+
+/**
+ * @brief Find the files of @a self with the same data, and make them
+ *     share it, so it's stored only once
+ * @param self The STAR, with every file added
+ * @param nthreads Number of threads to hash files with
+ * @returns `true` if successful, `false` otherwise
+ *
+ * Must be called before `star_file_offsets()`; the data of the files
+ * that share another's is freed.
  */
-bool star_add_file (struct STAR * self, u32 idx, const u8 * path, u32 size, Stream * in);
+bool star_dedup (struct STAR * self, unsigned nthreads);
+
+/**
+ * @brief Split the files of @a self in content defined chunks, and
+ *     make chunks with the same data share it, so it's stored only once
+ * @param self The STAR, with every file added
+ * @param nthreads Number of threads to split files with
+ * @returns `true` if successful, `false` otherwise
+ *
+ * Must be called before `star_file_offsets()`, and after
+ * `star_dedup()`, if at all. Chunks are cut where a rolling hash of the
+ * data matches a pattern, so data inserted or removed in a file only
+ * changes the chunks around it.
+ */
+bool star_chunk (struct STAR * self, unsigned nthreads);
+
+/**
+ * @brief Put the data of the small files of @a self, that aren't split
+ *     in chunks, one after the other in solid blocks
+ * @param self The STAR, with every file added
+ * @returns `true` if successful, `false` otherwise
+ *
+ * Must be called before `star_compress()` and `star_file_offsets()`,
+ * and after `star_dedup()` and `star_chunk()`, if at all. Neighbouring
+ * files go in the same block, and with `star_compress()` each block is
+ * compressed as a whole, so small files compress better together; a
+ * block is decoded once to extract all of its files.
+ */
+bool star_solid (struct STAR * self);
+
+/**
+ * @brief Make a dictionary out of samples of the files of @a self, for
+ *     `star_compress()` with `STAR_CODEC_LZ_DICT`
+ * @param self The STAR, with every file added
+ * @returns `true` if successful, even if the files have nothing in
+ *     common to make a dictionary of, `false` otherwise
+ *
+ * Must be called before `star_compress()` and `star_file_offsets()`,
+ * and after `star_dedup()`, if at all. The dictionary is made of the
+ * pieces of the beggining of files with the most substrings found in
+ * many files; it's stored once, and small files that look alike
+ * compress well against it, even on their own.
+ */
+bool star_train (struct STAR * self);
+
+/**
+ * @brief Compress the data of the files of @a self with @a codec
+ * @param self The STAR, with every file added
+ * @param codec The codec, see `enum StarCodec`
+ * @param nthreads Number of threads to compress files with
+ * @returns `true` if successful, `false` otherwise
+ *
+ * Must be called before `star_file_offsets()`, and after
+ * `star_dedup()` and `star_chunk()`, if at all; each chunk is
+ * compressed on its own. Big files not split in chunks are split in
+ * blocks of the same size, so that they too can be compressed on many
+ * threads; the result is the same for any number of threads. Big
+ * pieces are probed first, by compressing a few samples of them, and
+ * the ones that don't get any smaller are stored as is, without
+ * wasting time compressing them; files whose own data is all stored
+ * as is are `STAR_F_INCOMPRESSIBLE`. Without
+ * a dictionary (see `star_train()`), `STAR_CODEC_LZ_DICT` is
+ * `STAR_CODEC_LZ`.
+ */
+bool star_compress (struct STAR * self, u8 codec, unsigned nthreads);
+
+/**
+ * @brief Calculate the checksum of each chunk of the files of @a self,
+ *     to check them on their own (see `STAR_F_CHUNK_CHECKSUM`)
+ * @param self The STAR, with every file added
+ * @param nthreads Number of threads to calculate checksums with
+ * @returns `true` if successful, `false` otherwise
+ *
+ * Must be called before `star_file_offsets()`, and after
+ * `star_dedup()` and `star_chunk()`, if at all. Big files not split in
+ * chunks are split in blocks, as by `star_compress()`, so that each of
+ * them has its checksum; the chunks of a file make a tree of
+ * checksums, with the file's checksum as its root, so `star_verify()`
+ * checks one file on many threads, and `star_read_range()` checks only
+ * what it reads.
+ */
+bool star_chunk_crc (struct STAR * self, unsigned nthreads);
 
 /**
  * @brief Calculate the offsets of all the archived files in @a self
  * @param self The STAR, ready to be written, except for the file offsets
  * @returns `false` if an error occurred, `true` otherwise
+ *
+ * Data is packed back to back, but with `self->align`, the data of each
+ * file (the first of its own chunks, if `STAR_F_CHUNKED`) or solid block
+ * of at least `self->align_min` bytes starts on a multiple of
+ * `self->align` from the beggining of the STAR, after zeroed padding;
+ * how much goes in `self->padding`.
+ *
+ * The size of the STAR, known from here on, goes in `self->size`, and,
+ * for a STAR of version 11, where its headers go in `self->header.hoffset`.
  */
 bool star_file_offsets (struct STAR * self);
 
@@ -190,12 +888,22 @@ bool star_file_offsets (struct STAR * self);
  */
 struct STAR * star_new (u32 nfiles);
 
+/**
+ * @brief Make room for @a n more files in @a self, after the ones it has
+ * @param self The STAR
+ * @param n Number of files to make room for
+ * @returns `true` if there's room for them, to be added (see
+ *     `star_add_file()`), `false` otherwise
+ */
+bool star_extend (struct STAR * self, u32 n);
+
 /***********************************************************
  * search functions
  **********************************************************/
 
 /**
- * @brief Search for an archived file named @a fname in @a self
+ * @brief Search for an archived file named @a fname in @a self,
+ *     that wasn't deleted (see `STAR_F_DELETED`)
  * @param self The STAR
  * @param fname The filename to search
  * @param The index of the searched file, `STAR_DNF` otherwise
@@ -1,25 +1,85 @@
+/* for `O_DIRECT` */
+#define _GNU_SOURCE
+
 /*
+ * <errno.h>
+ *  EINVAL
+ *  ENXIO
+ *  errno
+ *
+ * <fcntl.h>
+ *  FALLOC_FL_KEEP_SIZE
+ *  O_CLOEXEC
+ *  O_CREAT
+ *  O_DIRECT
+ *  O_RDONLY
+ *  O_TRUNC
+ *  O_WRONLY
+ *  POSIX_FADV_DONTNEED
+ *  POSIX_FADV_NORMAL
+ *  POSIX_FADV_RANDOM
+ *  POSIX_FADV_SEQUENTIAL
+ *  POSIX_FADV_WILLNEED
+ *  fallocate()
+ *  open()
+ *  posix_fadvise()
+ *
  * <stdbool.h>
  *  bool
  *
+ * <stdint.h>
+ *  SIZE_MAX
+ *  UINT64_MAX
+ *  uint64_t
+ *
  * <stdio.h>
  *  FILE
+ *  SEEK_CUR
+ *  SEEK_SET
  *  fclose()
+ *  fflush()
+ *  fileno()
  *  fread()
+ *  fseeko()
+ *  ftello()
  *  fwrite()
+ *  off_t
  *
  * <stdlib.h>
  *  free()
+ *  malloc()
+ *  posix_memalign()
  *  size_t
  *
  * <string.h>
  *  memcpy()
  *  memset()
+ *
+ * <sys/stat.h>
+ *  S_ISREG()
+ *  fstat()
+ *  struct stat
+ *
+ * <unistd.h>
+ *  SEEK_DATA
+ *  SEEK_HOLE
+ *  close()
+ *  copy_file_range()
+ *  ftruncate()
+ *  lseek()
+ *  pread()
+ *  pwrite()
+ *  ssize_t
  */
+#include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*
  * <utils/common.h>
@@ -33,6 +93,35 @@
 
 #include "stream.h"
 
+/**
+ * @brief Alignment of the buffers, offsets and sizes of the reads and
+ *     writes of a direct Stream, in bytes
+ */
+#define STREAM_DIRECT_ALIGN (1 << 12)
+
+/**
+ * @brief Size of the buffer of a direct Stream, in bytes
+ */
+#define STREAM_DIRECT_BUF (1 << 20)
+
+/**
+ * @brief How far ahead of a `STREAM_HINT_SEQUENTIAL` Stream the page
+ *     cache reads, and how far behind it it drops what was read, in bytes
+ */
+#define STREAM_HINT_WINDOW (1 << 23)
+
+/**
+ * @brief Bytes read from a `STREAM_HINT_SEQUENTIAL` Stream between
+ *     moving its windows
+ */
+#define STREAM_HINT_STEP (1 << 20)
+
+/**
+ * @brief Size of the buffer `stream_copy()` copies through, when the
+ *     kernel can't copy, in bytes
+ */
+#define STREAM_COPY_BUF (1 << 20)
+
 /**
  * @brief Check if @a self is a valid Stream
  * @parm self The Stream
@@ -42,7 +131,116 @@ static inline bool _stream_check_type (const Stream * self)
 {
     return self != NULL
         && (self->type == _STREAM_TYPE_RAW
-        || self->type == _STREAM_TYPE_FILE);
+        || self->type == _STREAM_TYPE_FILE
+        || self->type == _STREAM_TYPE_DIRECT);
+}
+
+/**
+ * @brief Read @a size bytes at @a offset of @a fd to @a out
+ * @param fd The file descriptor
+ * @param out Where to read to
+ * @param size Number of bytes to read
+ * @param offset Offset of the bytes in @a fd
+ * @returns Number of bytes read, less than @a size only at the end of
+ *     @a fd or if an error occurred
+ */
+static size_t _stream_pread_fd (int fd, void * out, size_t size, uint64_t offset)
+{
+    size_t ret = 0;
+
+    /* `pread()` may read less than asked, and not be done */
+    while (ret < size) {
+        ssize_t r = pread(fd, (char *) out + ret, size - ret, (off_t) (offset + ret));
+        if (r <= 0)
+            break;
+        ret += (size_t) r;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Write the buffer of the direct Stream @a self to its file,
+ *     padded to `STREAM_DIRECT_ALIGN`, and cut the padding off the file
+ * @param self The direct Stream, opened for writing
+ * @returns `true` if the buffer was written, `false` otherwise
+ *
+ * The buffer is kept, and written whole again when it fills up; if
+ * nothing was added to it since it was last written, it isn't.
+ */
+static bool _stream_direct_flush (Stream * self)
+{
+    size_t len = self->s.d.blen;
+    if (len == self->s.d.bflushed)
+        return true;
+
+    size_t pad = (STREAM_DIRECT_ALIGN - len % STREAM_DIRECT_ALIGN) % STREAM_DIRECT_ALIGN;
+    memset(self->s.d.buf + len, 0, pad);
+
+    for (size_t done = 0; done < len + pad; ) {
+        ssize_t w = pwrite(self->s.d.fd, self->s.d.buf + done, len + pad - done,
+                (off_t) (self->s.d.boff + done));
+        if (w <= 0)
+            return false;
+        done += (size_t) w;
+    }
+
+    bool ret = pad == 0
+        || ftruncate(self->s.d.fd, (off_t) (self->s.d.boff + len)) == 0;
+    if (ret)
+        self->s.d.bflushed = len;
+    return ret;
+}
+
+/**
+ * @brief Forget how @a self was going to be read
+ * @param self The Stream
+ */
+static void _stream_hint_reset (Stream * self)
+{
+    self->hint = STREAM_HINT_NONE;
+    self->ahead = 0;
+    self->dropped = 0;
+    self->since = 0;
+}
+
+/**
+ * @brief Move the windows of a `STREAM_HINT_SEQUENTIAL` FILE Stream,
+ *     after @a n more bytes were read
+ * @param self The Stream
+ * @param n Number of bytes just read
+ */
+static void _stream_hint_read (Stream * self, uint64_t n)
+{
+    if (self->hint != STREAM_HINT_SEQUENTIAL || self->type != _STREAM_TYPE_FILE)
+        return;
+
+    /* finding where it is costs a syscall, not done on every read */
+    self->since += n;
+    if (self->since < STREAM_HINT_STEP)
+        return;
+    self->since = 0;
+
+    int fd = fileno(self->s.f);
+    off_t cur = ftello(self->s.f);
+    if (cur < 0)
+        return;
+    uint64_t pos = (uint64_t) cur;
+
+    /* keep reading ahead of it */
+    if (pos + STREAM_HINT_WINDOW > self->ahead) {
+        uint64_t from = (pos > self->ahead) ? pos : self->ahead;
+        uint64_t to = pos + 2 * STREAM_HINT_WINDOW;
+        posix_fadvise(fd, (off_t) from, (off_t) (to - from), POSIX_FADV_WILLNEED);
+        self->ahead = to;
+    }
+
+    /* and drop what was read, but a window behind it, in case it comes back */
+    if (pos > self->dropped + 2 * STREAM_HINT_WINDOW) {
+        uint64_t to = pos - STREAM_HINT_WINDOW;
+        posix_fadvise(fd, (off_t) self->dropped, (off_t) (to - self->dropped), POSIX_FADV_DONTNEED);
+        self->dropped = to;
+    }
 }
 
 void stream_close (Stream * self)
@@ -54,6 +252,13 @@ void stream_close (Stream * self)
         if (self->s.r.ptr != NULL)
             free(self->s.r.ptr);
         memset(&self->s.r, 0, sizeof(self->s.r));
+    } else if (self->type == _STREAM_TYPE_DIRECT) {
+        /* only what wasn't already written by `stream_flush()` */
+        if (self->s.d.write && self->s.d.blen > self->s.d.bflushed)
+            _stream_direct_flush(self);
+        free(self->s.d.buf);
+        close(self->s.d.fd);
+        memset(&self->s.d, 0, sizeof(self->s.d));
     } else {
         fclose(self->s.f);
         self->s.f = NULL;
@@ -69,6 +274,40 @@ bool stream_from_file (Stream * self, FILE * file)
 
     self->type = _STREAM_TYPE_FILE;
     self->s.f = file;
+    _stream_hint_reset(self);
+
+    return true;
+}
+
+bool stream_from_direct (Stream * self, const char * path, bool write)
+{
+    if (self == NULL || path == NULL)
+        return false;
+
+    int flags = O_CLOEXEC | ((write) ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY);
+    int fd = open(path, flags | O_DIRECT, 0666);
+
+    /* filesystems without `O_DIRECT` refuse it */
+    if (fd < 0 && errno == EINVAL)
+        fd = open(path, flags, 0666);
+    if (fd < 0)
+        return false;
+
+    void * buf = NULL;
+    if (posix_memalign(&buf, STREAM_DIRECT_ALIGN, STREAM_DIRECT_BUF) != 0) {
+        close(fd);
+        return false;
+    }
+
+    self->type = _STREAM_TYPE_DIRECT;
+    self->s.d.fd = fd;
+    self->s.d.write = write;
+    self->s.d.buf = buf;
+    self->s.d.boff = 0;
+    self->s.d.blen = 0;
+    self->s.d.bflushed = 0;
+    self->s.d.offset = 0;
+    _stream_hint_reset(self);
 
     return true;
 }
@@ -82,6 +321,7 @@ bool stream_from_raw (Stream * self, void * ptr, size_t size)
     self->s.r.offset = 0;
     self->s.r.ptr = ptr;
     self->s.r.size = size;
+    _stream_hint_reset(self);
 
     return true;
 }
@@ -105,16 +345,90 @@ bool stream_from_raw (Stream * self, void * ptr, size_t size)
         return nmemb2cp;                                     \
     } while (0)
 
+/**
+ * @brief Read @a size bytes from the direct Stream @a self to @a out,
+ *     through its buffer
+ * @param self The direct Stream, opened for reading
+ * @param out Where to read to
+ * @param size Number of bytes to read
+ * @returns Number of bytes read
+ */
+static size_t _stream_direct_read (Stream * self, void * out, size_t size)
+{
+    size_t ret = 0;
+
+    while (ret < size) {
+        uint64_t off = self->s.d.offset;
+
+        /* refill the buffer with the aligned piece around `off` */
+        if (off < self->s.d.boff || off - self->s.d.boff >= self->s.d.blen) {
+            self->s.d.boff = off - off % STREAM_DIRECT_ALIGN;
+            self->s.d.blen = _stream_pread_fd(self->s.d.fd, self->s.d.buf,
+                    STREAM_DIRECT_BUF, self->s.d.boff);
+            if (off - self->s.d.boff >= self->s.d.blen)
+                break;
+        }
+
+        size_t at = (size_t) (off - self->s.d.boff);
+        size_t n = min(size - ret, self->s.d.blen - at);
+        memcpy((char *) out + ret, self->s.d.buf + at, n);
+        self->s.d.offset += n;
+        ret += n;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Write @a size bytes from @a in to the direct Stream @a self,
+ *     through its buffer
+ * @param self The direct Stream, opened for writing
+ * @param in Where to write from
+ * @param size Number of bytes to write
+ * @returns Number of bytes written
+ */
+static size_t _stream_direct_write (Stream * self, const void * in, size_t size)
+{
+    size_t ret = 0;
+
+    while (ret < size) {
+        size_t n = min(size - ret, STREAM_DIRECT_BUF - self->s.d.blen);
+        memcpy(self->s.d.buf + self->s.d.blen, (const char *) in + ret, n);
+        self->s.d.blen += n;
+        self->s.d.offset += n;
+        ret += n;
+
+        /* full buffers are aligned, and the file grows by them */
+        if (self->s.d.blen == STREAM_DIRECT_BUF) {
+            if (!_stream_direct_flush(self))
+                break;
+            self->s.d.boff += STREAM_DIRECT_BUF;
+            self->s.d.blen = 0;
+            self->s.d.bflushed = 0;
+        }
+    }
+
+    return ret;
+}
+
 size_t stream_read (Stream * self, void * out, size_t size, size_t nmemb)
 {
     if (!_stream_check_type(self) || out == NULL)
         return 0;
 
-    if (self->type == _STREAM_TYPE_FILE)
-        return fread(out, size, nmemb, self->s.f);
+    if (self->type == _STREAM_TYPE_FILE) {
+        size_t ret = fread(out, size, nmemb, self->s.f);
+        _stream_hint_read(self, (uint64_t) ret * size);
+        return ret;
+    }
+
+    if (self->type == _STREAM_TYPE_DIRECT)
+        return (size == 0 || self->s.d.write || nmemb > SIZE_MAX / size) ?
+            0 :
+            _stream_direct_read(self, out, size * nmemb) / size ;
 
     /* _STREAM_TYPE_RAW */
-    _stream_rw_raw(out, self->s.r.ptr, self->s.r.size,
+    _stream_rw_raw(out, (char *) self->s.r.ptr + self->s.r.offset, self->s.r.size,
             self->s.r.offset, size, nmemb);
 }
 
@@ -126,12 +440,289 @@ size_t stream_write (Stream * self, const void * in, size_t size, size_t nmemb)
     if (self->type == _STREAM_TYPE_FILE)
         return fwrite(in, size, nmemb, self->s.f);
 
+    if (self->type == _STREAM_TYPE_DIRECT)
+        return (size == 0 || !self->s.d.write || nmemb > SIZE_MAX / size) ?
+            0 :
+            _stream_direct_write(self, in, size * nmemb) / size ;
+
     /* _STREAM_TYPE_RAW */
-    _stream_rw_raw(self->s.r.ptr, in, self->s.r.size,
+    _stream_rw_raw((char *) self->s.r.ptr + self->s.r.offset, in, self->s.r.size,
             self->s.r.offset, size, nmemb);
 }
 #undef _stream_rw_raw
 
+bool stream_seek (Stream * self, uint64_t offset)
+{
+    if (!_stream_check_type(self))
+        return false;
+
+    if (self->type == _STREAM_TYPE_FILE) {
+        /* already there, keep what's buffered */
+        off_t cur = ftello(self->s.f);
+        return (cur >= 0 && (uint64_t) cur == offset)
+            || fseeko(self->s.f, (off_t) offset, SEEK_SET) == 0;
+    }
+
+    /* written only sequentially; read anywhere */
+    if (self->type == _STREAM_TYPE_DIRECT) {
+        if (self->s.d.write)
+            return offset == self->s.d.offset;
+        self->s.d.offset = offset;
+        return true;
+    }
+
+    /* _STREAM_TYPE_RAW */
+    if (offset > self->s.r.size)
+        return false;
+
+    self->s.r.offset = (size_t) offset;
+    return true;
+}
+
+size_t stream_pread (Stream * self, void * out, size_t size, uint64_t offset)
+{
+    if (!_stream_check_type(self) || out == NULL)
+        return 0;
+
+    if (self->type == _STREAM_TYPE_FILE)
+        return _stream_pread_fd(fileno(self->s.f), out, size, offset);
+
+    /* the aligned pieces around what's asked, not through the buffer */
+    if (self->type == _STREAM_TYPE_DIRECT) {
+        uint64_t start = offset - offset % STREAM_DIRECT_ALIGN;
+        uint64_t skip = offset - start;
+        if (size == 0 || size > SIZE_MAX - skip - STREAM_DIRECT_ALIGN)
+            return 0;
+
+        size_t len = (size_t) (skip + size);
+        len += (STREAM_DIRECT_ALIGN - len % STREAM_DIRECT_ALIGN) % STREAM_DIRECT_ALIGN;
+
+        void * buf = NULL;
+        if (posix_memalign(&buf, STREAM_DIRECT_ALIGN, len) != 0)
+            return 0;
+
+        size_t got = _stream_pread_fd(self->s.d.fd, buf, len, start);
+        size_t ret = (got > skip) ?
+            min(size, got - (size_t) skip) :
+            0 ;
+        memcpy(out, (char *) buf + skip, ret);
+        free(buf);
+        return ret;
+    }
+
+    /* _STREAM_TYPE_RAW */
+    if (offset >= self->s.r.size)
+        return 0;
+
+    size_t n = min(size, self->s.r.size - (size_t) offset);
+    memcpy(out, (char *) self->s.r.ptr + offset, n);
+    return n;
+}
+
+uint64_t stream_copy (Stream * self, Stream * in, uint64_t size, uint64_t offset)
+{
+    if (!_stream_check_type(self) || !_stream_check_type(in))
+        return 0;
+
+    uint64_t ret = 0;
+
+    /* the kernel copies past the FILE, that has to catch up after */
+    if (self->type == _STREAM_TYPE_FILE && in->type == _STREAM_TYPE_FILE
+            && fflush(self->s.f) == 0) {
+        off_t cur = ftello(self->s.f);
+        off_t from = (off_t) offset;
+        off_t to = cur;
+
+        while (cur >= 0 && ret < size) {
+            ssize_t n = copy_file_range(fileno(in->s.f), &from,
+                    fileno(self->s.f), &to, (size_t) min(size - ret, (uint64_t) 1 << 30), 0);
+            if (n <= 0)
+                break;
+            ret += (uint64_t) n;
+        }
+
+        if (cur >= 0 && fseeko(self->s.f, to, SEEK_SET) != 0)
+            return 0;
+    }
+
+    if (ret == size)
+        return ret;
+
+    /* what the kernel didn't copy, through user space */
+    void * buf = malloc((size_t) min(size - ret, (uint64_t) STREAM_COPY_BUF));
+    if (buf == NULL)
+        return ret;
+
+    while (ret < size) {
+        size_t n = stream_pread(in, buf, (size_t) min(size - ret, (uint64_t) STREAM_COPY_BUF), offset + ret);
+        if (n == 0 || stream_write(self, buf, 1, n) != n)
+            break;
+        ret += n;
+    }
+
+    free(buf);
+    return ret;
+}
+
+bool stream_size (Stream * self, uint64_t * size)
+{
+    if (!_stream_check_type(self) || size == NULL)
+        return false;
+
+    if (self->type == _STREAM_TYPE_FILE || self->type == _STREAM_TYPE_DIRECT) {
+        int fd = (self->type == _STREAM_TYPE_FILE) ?
+            fileno(self->s.f) :
+            self->s.d.fd ;
+        struct stat st;
+        /* pipes and such have no size to speak of */
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 0)
+            return false;
+        *size = (uint64_t) st.st_size;
+        return true;
+    }
+
+    /* _STREAM_TYPE_RAW */
+    *size = self->s.r.size;
+    return true;
+}
+
+bool stream_hint (Stream * self, enum StreamHint hint)
+{
+    if (!_stream_check_type(self))
+        return false;
+
+    _stream_hint_reset(self);
+    self->hint = hint;
+
+    /* raw Streams are already in memory, direct ones bypass the cache */
+    if (self->type != _STREAM_TYPE_FILE)
+        return true;
+
+    int fd = fileno(self->s.f);
+    int advice = (hint == STREAM_HINT_SEQUENTIAL) ? POSIX_FADV_SEQUENTIAL :
+        (hint == STREAM_HINT_RANDOM) ? POSIX_FADV_RANDOM :
+        POSIX_FADV_NORMAL ;
+    if (posix_fadvise(fd, 0, 0, advice) != 0)
+        return false;
+
+    /* start reading ahead of where it is */
+    off_t cur = ftello(self->s.f);
+    if (hint == STREAM_HINT_SEQUENTIAL && cur >= 0) {
+        self->ahead = (uint64_t) cur + 2 * STREAM_HINT_WINDOW;
+        self->dropped = (uint64_t) cur;
+        posix_fadvise(fd, cur, 2 * STREAM_HINT_WINDOW, POSIX_FADV_WILLNEED);
+    }
+
+    return true;
+}
+
+bool stream_willneed (Stream * self, uint64_t offset, uint64_t size)
+{
+    if (!_stream_check_type(self))
+        return false;
+
+    return self->type != _STREAM_TYPE_FILE
+        || size == 0
+        || posix_fadvise(fileno(self->s.f), (off_t) offset, (off_t) size, POSIX_FADV_WILLNEED) == 0;
+}
+
+bool stream_reserve (Stream * self, uint64_t size)
+{
+    uint64_t offset = 0;
+    if (!stream_tell(self, &offset))
+        return false;
+
+    if (self->type == _STREAM_TYPE_RAW)
+        return size <= self->s.r.size - offset;
+
+    if (size == 0)
+        return true;
+
+    int fd = (self->type == _STREAM_TYPE_FILE) ?
+        fileno(self->s.f) :
+        self->s.d.fd ;
+
+    /* the size is left to the writes, in case they fall short */
+    return fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t) offset, (off_t) size) == 0;
+}
+
+bool stream_data (Stream * self, uint64_t offset, uint64_t * data, uint64_t * hole)
+{
+    if (!_stream_check_type(self) || data == NULL || hole == NULL)
+        return false;
+
+    if (self->type == _STREAM_TYPE_RAW) {
+        bool in = offset < self->s.r.size;
+        *data = (in) ? offset : UINT64_MAX;
+        *hole = (in) ? self->s.r.size : UINT64_MAX;
+        return true;
+    }
+
+    int fd = (self->type == _STREAM_TYPE_FILE) ?
+        fileno(self->s.f) :
+        self->s.d.fd ;
+
+    /* `lseek()` moves the file descriptor, not where the FILE reads */
+    off_t cur = lseek(fd, 0, SEEK_CUR);
+    if (cur < 0)
+        return false;
+
+    bool ret = false;
+    off_t d = lseek(fd, (off_t) offset, SEEK_DATA);
+    if (d >= 0) {
+        off_t h = lseek(fd, d, SEEK_HOLE);
+        ret = h >= 0;
+        *data = (uint64_t) d;
+        *hole = (uint64_t) h;
+    } else if (errno == ENXIO) {
+        ret = true;
+        *data = UINT64_MAX;
+        *hole = UINT64_MAX;
+    }
+
+    return lseek(fd, cur, SEEK_SET) == cur && ret;
+}
+
+bool stream_truncate (Stream * self, uint64_t size)
+{
+    return _stream_check_type(self)
+        && self->type == _STREAM_TYPE_FILE
+        && fflush(self->s.f) == 0
+        && ftruncate(fileno(self->s.f), (off_t) size) == 0;
+}
+
+bool stream_tell (Stream * self, uint64_t * offset)
+{
+    if (!_stream_check_type(self) || offset == NULL)
+        return false;
+
+    if (self->type == _STREAM_TYPE_FILE) {
+        off_t cur = ftello(self->s.f);
+        if (cur < 0)
+            return false;
+        *offset = (uint64_t) cur;
+        return true;
+    }
+
+    *offset = (self->type == _STREAM_TYPE_RAW) ?
+        self->s.r.offset :
+        self->s.d.offset ;
+    return true;
+}
+
+bool stream_flush (Stream * self)
+{
+    if (!_stream_check_type(self))
+        return false;
+
+    if (self->type == _STREAM_TYPE_FILE)
+        return fflush(self->s.f) == 0;
+
+    return self->type == _STREAM_TYPE_RAW
+        || !self->s.d.write
+        || _stream_direct_flush(self);
+}
+
 FILE * stream_file (Stream * self)
 {
     return (_stream_check_type(self) && self->type == _STREAM_TYPE_FILE) ?
@@ -5,6 +5,9 @@
  * <stdbool.h>
  *  bool
  *
+ * <stdint.h>
+ *  uint64_t
+ *
  * <stdio.h>
  *  FILE
  *
@@ -12,9 +15,23 @@
  *  size_t
  */
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/**
+ * @brief How a Stream is going to be read, for the page cache, see
+ *     `stream_hint()`
+ */
+enum StreamHint {
+    /** No idea */
+    STREAM_HINT_NONE,
+    /** In order, once */
+    STREAM_HINT_SEQUENTIAL,
+    /** Here and there, as told with `stream_willneed()` */
+    STREAM_HINT_RANDOM,
+};
+
 /**
  * @brief The Stream type
  */
@@ -27,6 +44,8 @@ typedef struct {
         _STREAM_TYPE_RAW,
         /** FILE stream */
         _STREAM_TYPE_FILE,
+        /** File descriptor, bypassing the page cache */
+        _STREAM_TYPE_DIRECT,
     } type;
 
     /** Where the data is held */
@@ -43,7 +62,34 @@ typedef struct {
             /** Pointer to the data */
             void * ptr;
         } r;
+
+        /** The file, for a Stream of type _STREAM_TYPE_DIRECT */
+        struct {
+            /** The file descriptor */
+            int fd;
+            /** Opened for writing, else for reading */
+            bool write;
+            /** Aligned buffer, all reads and writes go through */
+            unsigned char * buf;
+            /** Offset of the file `buf` has the data of */
+            uint64_t boff;
+            /** Number of bytes of `buf` with data */
+            size_t blen;
+            /** Number of bytes of `buf` already written to the file */
+            size_t bflushed;
+            /** Where it will be reading/writing next */
+            uint64_t offset;
+        } d;
     } s;
+
+    /** How it's going to be read, see `stream_hint()` */
+    enum StreamHint hint;
+    /** Offset up to which the page cache was told to read ahead */
+    uint64_t ahead;
+    /** Offset up to which what was read was dropped from the page cache */
+    uint64_t dropped;
+    /** Bytes read since `ahead` and `dropped` were last moved */
+    uint64_t since;
 } Stream;
 
 /**
@@ -62,6 +108,23 @@ FILE * stream_file (Stream * self);
  */
 bool stream_from_file (Stream * self, FILE * file);
 
+/**
+ * @brief Open the file at @a path as a Stream that bypasses the page
+ *     cache (with `O_DIRECT`, where supported)
+ * @param self The Stream
+ * @param path Path of the file
+ * @param write `true` to create (or truncate) the file and write it,
+ *     only ever sequentially, `false` to read it
+ * @returns `false` if the file couldn't be opened, `true` otherwise
+ *
+ * Everything goes through an aligned buffer, so the file is read and
+ * written in big, aligned pieces, whatever the reads and writes to
+ * @a self; `stream_pread()` reads the aligned pieces around what it's
+ * asked. Files on filesystems without `O_DIRECT` are still opened,
+ * and go through the page cache.
+ */
+bool stream_from_direct (Stream * self, const char * path, bool write);
+
 /**
  * @brief Create a new Stream from @a ptr with @a size
  * @param self The Stream
@@ -94,6 +157,139 @@ size_t stream_read (Stream * self, void * out, size_t size, size_t nmemb);
  */
 size_t stream_write (Stream * self, const void * in, size_t size, size_t nmemb);
 
+/**
+ * @brief Similar to `fseeko()` from <stdio.h>, move @a self to
+ *     @a offset bytes from its beggining
+ * @param self The Stream
+ * @param offset Where to read/write next
+ * @returns `true` if @a self was moved, `false` otherwise
+ */
+bool stream_seek (Stream * self, uint64_t offset);
+
+/**
+ * @brief Similar to `pread()` from <unistd.h>, read @a size bytes at
+ *     @a offset of @a self to @a out, without moving @a self
+ * @param self The Stream
+ * @param out Where to read to
+ * @param size Number of bytes to read
+ * @param offset Offset of the bytes in @a self
+ * @returns Number of bytes read, less than @a size only at the end of
+ *     @a self or if an error occurred
+ *
+ * Many threads may read the same Stream at once this way; for a FILE
+ * Stream, its buffer is bypassed, so whatever was written to it has to
+ * be flushed first.
+ */
+size_t stream_pread (Stream * self, void * out, size_t size, uint64_t offset);
+
+/**
+ * @brief Copy @a size bytes at @a offset of @a in to @a self, where it
+ *     writes next, without moving @a in
+ * @param self The Stream to write to
+ * @param in The Stream to read from
+ * @param size Number of bytes to copy
+ * @param offset Offset of the bytes in @a in
+ * @returns Number of bytes copied, less than @a size only at the end of
+ *     @a in or if an error occurred
+ *
+ * Between FILE Streams, the kernel copies it, with `copy_file_range()`,
+ * without it going through user space, and on file systems that can,
+ * without copying it at all; whatever it can't copy, e.g. across file
+ * systems, is read and written as usual.
+ */
+uint64_t stream_copy (Stream * self, Stream * in, uint64_t size, uint64_t offset);
+
+/**
+ * @brief Get the size of @a self
+ * @param self The Stream
+ * @param size Where to put the size, in bytes
+ * @returns `true` if the size is known, `false` otherwise
+ */
+bool stream_size (Stream * self, uint64_t * size);
+
+/**
+ * @brief Tell the page cache how @a self is going to be read, with
+ *     `posix_fadvise()`
+ * @param self The Stream
+ * @param hint How @a self is going to be read
+ * @returns `true` if the page cache was told, or there's none to tell
+ *     (for other than FILE Streams), `false` otherwise
+ *
+ * With `STREAM_HINT_SEQUENTIAL`, as @a self is read, the page cache
+ * keeps reading a few MiB ahead of it, and drops what was read a few
+ * MiB behind it; with `STREAM_HINT_RANDOM`, it reads only what it's
+ * told to, with `stream_willneed()`.
+ */
+bool stream_hint (Stream * self, enum StreamHint hint);
+
+/**
+ * @brief Tell the page cache to start reading @a size bytes at
+ *     @a offset of @a self, that are going to be read soon
+ * @param self The Stream
+ * @param offset Offset of the bytes in @a self
+ * @param size Number of bytes
+ * @returns `true` if the page cache was told, or there's none to tell,
+ *     `false` otherwise
+ */
+bool stream_willneed (Stream * self, uint64_t offset, uint64_t size);
+
+/**
+ * @brief Allocate room on disk for the next @a size bytes written to
+ *     @a self, with `fallocate()`, without changing its size
+ * @param self The Stream, opened with the "wb" mode
+ * @param size Number of bytes that are going to be written
+ * @returns `true` if the room was allocated, or there's no disk (for
+ *     RAW Streams, if it fits), `false` otherwise, e.g. if the file
+ *     system doesn't support it
+ *
+ * Allocated at once, a big file is laid out in fewer pieces, and the
+ * file system's metadata isn't updated on every write.
+ */
+bool stream_reserve (Stream * self, uint64_t size);
+
+/**
+ * @brief Find the first run of data of @a self at or after @a offset,
+ *     with `lseek()`'s `SEEK_DATA` and `SEEK_HOLE`
+ * @param self The Stream, opened with the "rb" mode
+ * @param offset Where to start looking
+ * @param data Where to put the offset of the run
+ * @param hole Where to put the offset of the hole after the run (or of
+ *     the end of @a self)
+ * @returns `true` if it was looked for, `false` otherwise, e.g. if the
+ *     file system can't tell
+ *
+ * If there's no data at or after @a offset, @a data and @a hole are set
+ * to `UINT64_MAX`. RAW Streams have no holes. Where it's reading from
+ * is left as it was.
+ */
+bool stream_data (Stream * self, uint64_t offset, uint64_t * data, uint64_t * hole);
+
+/**
+ * @brief Similar to `ftruncate()` from <unistd.h>, set the size of
+ *     @a self to @a size, zero filled if it grows
+ * @param self A FILE Stream, opened with the "wb" mode
+ * @param size The size, in bytes
+ * @returns `true` if the size was set, `false` otherwise
+ */
+bool stream_truncate (Stream * self, uint64_t size);
+
+/**
+ * @brief Similar to `ftello()` from <stdio.h>, get where @a self will
+ *     be reading/writing next
+ * @param self The Stream
+ * @param offset Where to put the offset, in bytes from the beggining
+ * @returns `true` if the offset is known, `false` otherwise
+ */
+bool stream_tell (Stream * self, uint64_t * offset);
+
+/**
+ * @brief Similar to `fflush()` from <stdio.h>, write whatever @a self
+ *     holds back to its file
+ * @param self The Stream
+ * @returns `true` if everything was written, `false` otherwise
+ */
+bool stream_flush (Stream * self);
+
 /**
  * @brief Get a pointer to the data associated with @a self
  * @param self The Stream
@@ -104,7 +300,8 @@ void * stream_raw (Stream * self);
 
 /**
  * @brief Close @a self and, if @a self isn't a FILE Stream, `free()`
- *     associated data
+ *     associated data; a direct Stream opened for writing writes what's
+ *     left in its buffer first
  * @param self The Stream
  */
 void stream_close (Stream * self);
@@ -0,0 +1,46 @@
+#!/bin/sh
+# test.sh STAR -- check the behaviour of the STAR binary given
+#
+# Each test runs in its own directory, under a temporary one that's
+# removed at the end; the first that fails stops the rest.
+
+set -e
+
+star=$(realpath "${1:-./star}")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+fail () {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# a path appended again finds the new file, named or not
+test_append_again () {
+    mkdir -p q
+    echo old > q/v.txt
+    "$star" c -E a.star q/v.txt 2>/dev/null
+    echo new > q/v.txt
+    "$star" a a.star q/v.txt 2>/dev/null
+    rm q/v.txt
+
+    "$star" x a.star q/v.txt 2>/dev/null
+    [ "$(cat q/v.txt)" = new ] || fail "named extraction got the old file"
+    rm q/v.txt
+
+    "$star" x a.star 2>/dev/null
+    [ "$(cat q/v.txt)" = new ] || fail "extraction got the old file"
+
+    [ "$("$star" l a.star | grep -c 'q/v.txt')" = 1 ] || fail "both files are listed"
+
+    "$star" p a.star 2>/dev/null
+    rm q/v.txt
+    "$star" x a.star q/v.txt 2>/dev/null
+    [ "$(cat q/v.txt)" = new ] || fail "compaction kept the old file"
+}
+
+for t in test_append_again; do
+    mkdir "$tmp/$t"
+    (cd "$tmp/$t" && $t)
+    echo "ok: $t"
+done